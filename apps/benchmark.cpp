@@ -2,31 +2,62 @@
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <vector>
 #include <chrono>
 
 #include "csketch/bitvector.hpp"
+#include "csketch/blocked.hpp"
+#include "csketch/code_cache.hpp"
 #include "csketch/column.hpp"
+#include "csketch/container.hpp"
+#include "csketch/dictionary.hpp"
+#include "csketch/estimate.hpp"
+#include "csketch/partition.hpp"
+#include "csketch/push_scan.hpp"
 #include "csketch/scan.hpp"
+#include "csketch/stream.hpp"
 
 using namespace csketch;
 
 struct Args {
     std::string base_file;
+    std::string packed_file; // FOR-bitpacked keys, instead of --base
     std::string sketch_file;
+    std::string pax_file; // blocked codes + keys, instead of --sketch (--base stays for the full scan)
     std::string map_json;
-    std::string dtype;    // u32/u64
-    std::string op;       // lt | eq | between
-    uint64_t v1 = 0, v2 = 0;
+    std::string manifest; // partitioned sketch, instead of --map
+    std::string container; // .csk, instead of --base/--sketch/--map
+    unsigned threads = 1;
+    std::string huge_pages = "thp"; // off | thp | explicit
+    std::string isa = "auto";       // scalar | sse4.2 | avx2 | avx512 | auto
+    std::string dtype;    // u32/u64/i32/i64/f32/f64/str
+    std::string dict_file;    // str: .dict
+    std::string strings_file; // str: original .strs, for a string-compare baseline
+    std::string op;       // lt | eq | between | prefix (str only)
+    std::string v1, v2 = "0";
     std::string csv;      // output CSV path
+    bool stream = false;  // time the sketch scan streaming from disk
+    bool cache = false;   // answer from a code-range cache (warm-up fills it)
+    bool push = false;    // also time a push scan counting matches per morsel
+    size_t morsel_rows = kMorselRows;
+    size_t chunk_rows = size_t(1) << 20;
 };
 
 static void usage() {
     std::cerr <<
-      "\nUsage: benchmark --base FILE --sketch FILE --map FILE --dtype {u32,u64}\n"
-      "                 --op {lt,eq,between} --v1 X [--v2 Y] --csv results/bench.csv\n\n";
+      "\nUsage: benchmark --base FILE --sketch FILE --map FILE --dtype {u32,u64,i32,i64,f32,f64}\n"
+      "                 --op {lt,le,gt,ge,eq,ne,between,in} --v1 X [--v2 Y] --csv results/bench.csv\n"
+      "                 [--manifest FILE instead of --map] [--threads N] [--huge-pages {off,thp,explicit}]\n"
+      "                 [--isa {scalar,sse4.2,avx2,avx512,auto}]\n"
+      "                 [--stream [--chunk-rows N]] [--cache] [--push [--morsel-rows N]]\n"
+      "       benchmark --packed FILE.packed ... (bitpacked keys, instead of --base; both scans decode it)\n"
+      "       benchmark --pax FILE.pax ... (blocked codes + keys for the sketch scan, instead of --sketch)\n"
+      "       benchmark --container FILE.csk --op ... --csv FILE (replaces --base/--sketch/--map/--dtype)\n"
+      "       benchmark --base IDS.bin --sketch FILE --map FILE --dtype str --dict FILE.dict\n"
+      "                 [--strings FILE.strs] --op {lt,eq,between,prefix} --v1 S [--v2 S] --csv FILE\n\n";
 }
 
 static Args parse(int argc, char** argv) {
@@ -38,21 +69,56 @@ static Args parse(int argc, char** argv) {
             return std::string(argv[++i]);
         };
         if (s=="--base") a.base_file = need("--base");
+        else if (s=="--packed") a.packed_file = need("--packed");
         else if (s=="--sketch") a.sketch_file = need("--sketch");
+        else if (s=="--pax") a.pax_file = need("--pax");
         else if (s=="--map") a.map_json = need("--map");
+        else if (s=="--manifest") a.manifest = need("--manifest");
+        else if (s=="--container") a.container = need("--container");
+        else if (s=="--threads") a.threads = static_cast<unsigned>(std::stoul(need("--threads")));
+        else if (s=="--huge-pages") a.huge_pages = need("--huge-pages");
+        else if (s=="--isa") a.isa = need("--isa");
+        else if (s=="--stream") a.stream = true;
+        else if (s=="--cache") a.cache = true;
+        else if (s=="--push") a.push = true;
+        else if (s=="--morsel-rows") a.morsel_rows = static_cast<size_t>(std::stoull(need("--morsel-rows")));
+        else if (s=="--chunk-rows") a.chunk_rows = static_cast<size_t>(std::stoull(need("--chunk-rows")));
         else if (s=="--dtype") a.dtype = need("--dtype");
+        else if (s=="--dict") a.dict_file = need("--dict");
+        else if (s=="--strings") a.strings_file = need("--strings");
         else if (s=="--op") a.op = need("--op");
-        else if (s=="--v1") a.v1 = std::stoull(need("--v1"));
-        else if (s=="--v2") a.v2 = std::stoull(need("--v2"));
+        else if (s=="--v1") a.v1 = need("--v1");
+        else if (s=="--v2") a.v2 = need("--v2");
         else if (s=="--csv") a.csv = need("--csv");
         else if (s=="-h"||s=="--help") { usage(); std::exit(0); }
         else throw std::runtime_error("unknown arg: "+s);
     }
-    if (a.base_file.empty()||a.sketch_file.empty()||a.map_json.empty()||
-        a.dtype.empty()||a.op.empty()||a.csv.empty()) {
+    if (a.op.empty()||a.csv.empty()||a.v1.empty()) {
         throw std::runtime_error("required args missing");
     }
-    if (a.op=="between" && a.v2<a.v1) std::swap(a.v1,a.v2);
+    if (!a.pax_file.empty()) {
+        if (!a.sketch_file.empty()||!a.packed_file.empty()||!a.manifest.empty()||!a.container.empty()||
+            a.stream||a.cache)
+            throw std::runtime_error("--pax replaces --sketch (no --packed/--manifest/--container/--stream/--cache)");
+        a.sketch_file = a.pax_file;
+    }
+    if (!a.packed_file.empty()) {
+        if (!a.base_file.empty()||!a.manifest.empty()||!a.container.empty()||a.stream)
+            throw std::runtime_error("--packed replaces --base and needs --map (no --manifest/--container/--stream)");
+        a.base_file = a.packed_file;
+    }
+    if (!a.container.empty()) {
+        if (!a.base_file.empty()||!a.sketch_file.empty()||!a.map_json.empty()||!a.manifest.empty())
+            throw std::runtime_error("--container replaces --base, --sketch, --map and --manifest");
+    } else if (a.base_file.empty()||a.sketch_file.empty()||(a.map_json.empty()==a.manifest.empty())||
+               a.dtype.empty()) {
+        throw std::runtime_error("required args missing");
+    }
+    if (a.stream && !a.manifest.empty()) throw std::runtime_error("--stream does not support --manifest");
+    if (a.push && (a.stream || !a.manifest.empty() || !a.pax_file.empty()))
+        throw std::runtime_error("--push does not support --stream, --manifest or --pax");
+    if (a.cache && (a.stream || !a.manifest.empty()))
+        throw std::runtime_error("--cache does not support --stream or --manifest");
     return a;
 }
 
@@ -66,9 +132,9 @@ static std::vector<uint8_t> slurp(const std::string& path) {
     return buf;
 }
 
-// Baseline full scan — no sketch
-static BitVector full_scan(const std::vector<uint64_t>& base, const QuerySpec& q) {
-    const size_t N = base.size();
+// Baseline full scan — no sketch (over order-preserving keys)
+template <class Base>
+static BitVector full_scan(const Base& base, size_t N, const QuerySpec& q) {
     BitVector out(N);
     if (q.op == QuerySpec::Op::LT) {
         for (size_t i=0;i<N;++i)
@@ -76,9 +142,29 @@ static BitVector full_scan(const std::vector<uint64_t>& base, const QuerySpec& q
     } else if (q.op == QuerySpec::Op::EQ) {
         for (size_t i=0;i<N;++i)
             if (base[i] == q.v1) out.set(i);
-    } else { // BETWEEN inclusive
+    } else if (q.op == QuerySpec::Op::BETWEEN) { // inclusive
         for (size_t i=0;i<N;++i)
             if (base[i] >= q.v1 && base[i] <= q.v2) out.set(i);
+    } else {
+        for (size_t i=0;i<N;++i)
+            if (q.matches(base[i])) out.set(i);
+    }
+    return out;
+}
+
+// String baseline: compare the original strings row by row
+static BitVector full_scan_strings(const StringColumn& strs, StringOp op,
+                                   const std::string& s1, const std::string& s2) {
+    const size_t N = strs.size();
+    BitVector out(N);
+    for (size_t i=0;i<N;++i) {
+        std::string_view v = strs[i];
+        bool hit = false;
+        if (op == StringOp::LT) hit = v < s1;
+        else if (op == StringOp::EQ) hit = v == s1;
+        else if (op == StringOp::BETWEEN) hit = v >= s1 && v <= s2;
+        else hit = v.substr(0, s1.size()) == s1;
+        if (hit) out.set(i);
     }
     return out;
 }
@@ -86,48 +172,120 @@ static BitVector full_scan(const std::vector<uint64_t>& base, const QuerySpec& q
 int main(int argc, char** argv) {
     try {
         Args args = parse(argc, argv);
+        memory_policy().huge_pages = parse_huge_pages(args.huge_pages);
+        isa_policy() = parse_isa(args.isa);
+        memory_policy().first_touch_threads = args.threads ? args.threads : default_threads();
 
         // Load map + base + sketch
-        LoadedMap L = load_map_json(args.map_json);
+        const bool partitioned = !args.manifest.empty();
+        Manifest M;
+        LoadedMap L;
+        std::optional<ContainerView> C;
+        std::optional<PackedColumn> P;
+        std::optional<BlockedView> X;
+        ColumnVector<uint64_t> base_keys;
+        std::vector<uint8_t> raw;
+        const uint64_t* base = nullptr;
+        const void* codes = nullptr;
+        size_t N = 0;
+        if (!args.container.empty()) {
+            C.emplace(args.container);
+            L = C->map();
+            if (args.dtype.empty()) args.dtype = L.dtype;
+            base = C->base();
+            codes = C->codes();
+            N = static_cast<size_t>(C->rows());
+        } else if (!args.packed_file.empty()) {
+            L = load_map_json(args.map_json);
+            P = PackedColumn::load(args.packed_file);
+            raw = slurp(args.sketch_file);
+            codes = raw.data();
+            N = P->size();
+            if (raw.size() != N * (L.code_bits / 8)) {
+                throw std::runtime_error("sketch length does not match base length");
+            }
+        } else {
+            if (partitioned) {
+                M = load_manifest(args.manifest);
+                L.dtype = M.dtype;
+                L.code_bits = M.code_bits;
+            } else {
+                L = load_map_json(args.map_json);
+            }
+            base_keys = read_column_keys(args.base_file, parse_dtype(args.dtype));
+            base = base_keys.data();
+            N = base_keys.size();
+            if (!args.pax_file.empty()) {
+                X.emplace(args.pax_file);
+                if (X->size() != N) throw std::runtime_error("blocked column length does not match base length");
+            } else {
+                raw = slurp(args.sketch_file);
+                codes = raw.data();
+                if (raw.size() != N * (L.code_bits / 8)) {
+                    throw std::runtime_error("sketch length does not match base length");
+                }
+            }
+        }
         if (args.dtype != L.dtype)
             std::cerr << "[warn] dtype mismatch: CLI=" << args.dtype
                       << ", map=" << L.dtype << "\n";
 
-        std::vector<uint64_t> base;
-        if (args.dtype=="u32") {
-            auto v = read_binary<uint32_t>(args.base_file);
-            base.assign(v.begin(), v.end());
-        } else {
-            base = read_binary<uint64_t>(args.base_file);
+        const DType dtype = parse_dtype(args.dtype);
+        const bool codes16 = (L.code_bits==16);
+        StreamInput S;
+        if (args.stream) {
+            S = C ? stream_container(args.container, *C)
+                  : stream_files(args.sketch_file, args.base_file, dtype, L.code_bits);
         }
-        const size_t N = base.size();
 
-        auto raw = slurp(args.sketch_file);
-        bool codes16 = (L.code_bits==16);
-        if ((!codes16 && raw.size()!=N*sizeof(uint8_t)) ||
-            (codes16 && raw.size()!=N*sizeof(uint16_t))) {
-            throw std::runtime_error("sketch length does not match base length");
+        // Build query spec (nullopt: string predicate that matches nothing)
+        std::optional<QuerySpec> q;
+        StringColumn strs;
+        StringOp sop = StringOp::EQ;
+        if (dtype == DType::STR) {
+            if (args.dict_file.empty()) throw std::runtime_error("--dtype str requires --dict");
+            if (args.op=="between" && args.v2<args.v1) std::swap(args.v1,args.v2);
+            StringDictionary dict = StringDictionary::load(args.dict_file);
+            sop = parse_string_op(args.op);
+            q = translate_string_predicate(dict, sop, args.v1, args.v2);
+            if (!args.strings_file.empty()) {
+                strs = read_strings(args.strings_file);
+                if (strs.size() != N) throw std::runtime_error("strings length does not match base length");
+            }
+        } else {
+            q = make_query(parse_query_op(args.op), args.v1, args.v2, dtype);
+            if (q->op == QuerySpec::Op::BETWEEN && parse_key(args.v1, dtype) != q->v1)
+                std::swap(args.v1,args.v2);
         }
-        const void* codes = raw.data();
-
-        // Build query spec
-        QuerySpec q;
-        if (args.op=="lt") q = {QuerySpec::Op::LT, args.v1, 0};
-        else if (args.op=="eq") q = {QuerySpec::Op::EQ, args.v1, 0};
-        else if (args.op=="between") q = {QuerySpec::Op::BETWEEN, args.v1, args.v2};
-        else throw std::runtime_error("unknown --op");
+        CodeRangeCache cache;
+        const std::string column_id = args.container.empty() ? args.sketch_file : args.container;
+        auto sketch_scan = [&]() {
+            if (!q) return BitVector(N);
+            if (args.stream) return scan_stream(L, S, *q, StreamOptions{args.chunk_rows, 4});
+            if (args.cache) {
+                return P ? cache.scan(column_id, L, codes, codes16, *P, N, *q)
+                         : cache.scan(column_id, L, codes, codes16, base, N, *q);
+            }
+            if (X) return scan_blocked(L, *X, *q, args.threads);
+            if (P) return scan_predicate(L, codes, codes16, *P, *q);
+            return partitioned ? scan_partitioned(M, codes, base, N, *q, args.threads)
+                               : scan_predicate(L, codes, codes16, base, N, *q);
+        };
 
         // Warm-up (optional) — run once without timing
-        (void) scan_predicate(L, codes, codes16, base, q);
+        (void) sketch_scan();
 
         // Time full scan
         auto t0 = std::chrono::steady_clock::now();
-        BitVector full = full_scan(base, q);
+        BitVector full = (dtype == DType::STR && !args.strings_file.empty())
+                             ? full_scan_strings(strs, sop, args.v1, args.v2)
+                             : !q ? BitVector(N)
+                             : P ? full_scan(*P, N, *q) : full_scan(base, N, *q);
         auto t1 = std::chrono::steady_clock::now();
 
         // Time sketch scan
         auto t2 = std::chrono::steady_clock::now();
-        BitVector sketch = scan_predicate(L, codes, codes16, base, q);
+        BitVector sketch = sketch_scan();
         auto t3 = std::chrono::steady_clock::now();
 
         using ms = std::chrono::duration<double, std::milli>;
@@ -165,7 +323,48 @@ int main(int argc, char** argv) {
                   << " matches=" << matches_full
                   << " full_ms=" << full_ms
                   << " sketch_ms=" << sketch_ms
-                  << " speedup=" << speedup << "x\n";
+                  << " speedup=" << speedup << "x"
+                  << " isa=" << isa_name(active_isa()) << "\n";
+        // Planner estimate from map stats only (maps built with per-code stats)
+        if (q && !partitioned && !L.stats.empty()) {
+            auto e0 = std::chrono::steady_clock::now();
+            const Selectivity est = estimate_selectivity(L, *q);
+            auto e1 = std::chrono::steady_clock::now();
+            using us = std::chrono::duration<double, std::micro>;
+            const double err = matches_full
+                ? 100.0 * (est.rows - static_cast<double>(matches_full)) / static_cast<double>(matches_full)
+                : est.rows;
+            std::cout << "estimate rows=" << est.rows << " [" << est.rows_lo << ", " << est.rows_hi << "]"
+                      << " actual=" << matches_full
+                      << " error=" << err << (matches_full ? "%" : " rows")
+                      << " estimate_us=" << std::chrono::duration_cast<us>(e1-e0).count() << "\n";
+        }
+        // Push scan: matches counted per morsel while in cache; no N-bit mask
+        if (args.push && q) {
+            const PushOptions opt{args.morsel_rows, args.threads};
+            std::vector<uint64_t> per_worker(push_worker_count(N, opt), 0);
+            auto count = [&](const MaskChunk& c) {
+                uint64_t n = 0;
+                for (size_t w = 0; w < (c.rows + 63) / 64; ++w) n += static_cast<uint64_t>(__builtin_popcountll(c.words[w]));
+                per_worker[c.worker] += n;
+            };
+            auto p0 = std::chrono::steady_clock::now();
+            if (P) scan_push(L, codes, codes16, *P, N, *q, count, opt);
+            else scan_push(L, codes, codes16, base, N, *q, count, opt);
+            auto p1 = std::chrono::steady_clock::now();
+            uint64_t pushed = 0;
+            for (uint64_t n : per_worker) pushed += n;
+            std::cout << "push matches=" << pushed
+                      << " push_ms=" << std::chrono::duration_cast<ms>(p1-p0).count()
+                      << " morsel_rows=" << opt.morsel_rows << "\n";
+            if (pushed != matches_full)
+                std::cerr << "[warn] count mismatch full=" << matches_full << " push=" << pushed << "\n";
+        }
+        if (args.cache) {
+            const auto cs = cache.stats();
+            std::cout << "cache hits=" << cs.hits << " misses=" << cs.misses
+                      << " evictions=" << cs.evictions << " bytes=" << cs.bytes << "\n";
+        }
         std::cout << "appended to " << args.csv << "\n";
 
         return 0;
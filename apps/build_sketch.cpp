@@ -8,8 +8,14 @@
 #include <utility>
 #include <vector>
 
+#include "csketch/blocked.hpp"
 #include "csketch/column.hpp"
 #include "csketch/compression_map.hpp"
+#include "csketch/container.hpp"
+#include "csketch/dictionary.hpp"
+#include "csketch/packed_column.hpp"
+#include "csketch/partition.hpp"
+#include "csketch/sketch.hpp"
 
 namespace {
 
@@ -20,15 +26,40 @@ struct Args {
   uint32_t codes = 1024;
   size_t sample = 10000;
   size_t unique_cutoff = 1;
+  bool optimal = false;
+  std::string workload;
+  uint64_t partition_rows = 0; // 0: one global map
+  std::string container;       // optional single-file .csk output
+  bool pack_base = false;      // also write <out>.packed (FOR-bitpacked keys)
+  bool pax = false;            // also write <out>.pax (codes and keys per block)
+  uint64_t block_rows = csketch::kBlockedRows;
+  unsigned threads = 0;
 };
 
 void usage() {
   std::cerr
-      << "Usage: build_sketch --in <column.bin> --out <basename> --dtype <u32|u64>\n"
-      << "       [--codes N] [--sample N] [--unique-cutoff N]\n"
+      << "Usage: build_sketch --in <column.bin|column.strs> --out <basename>\n"
+      << "       --dtype <u32|u64|i32|i64|f32|f64|str>\n"
+      << "       [--codes N] [--sample N] [--unique-cutoff N] [--optimal [--workload FILE]]\n"
+      << "       [--partition-rows N] [--threads N] [--container FILE.csk]\n"
+      << "       [--pack-base] [--pax [--block-rows N]]\n"
       << "  --codes: target total codes (default 1024)\n"
       << "  --sample: sampled non-unique values to build ranges (default 10000)\n"
-      << "  --unique-cutoff: max frequency to treat value as unique (default 1)\n";
+      << "  --unique-cutoff: max frequency to treat value as unique (default 1)\n"
+      << "  --optimal: choose uniques/endpoints minimising expected base probes\n"
+      << "  --workload: whitespace-separated query constants to weight --optimal\n"
+      << "  --partition-rows: fit one map per N-row partition (rounded up to a\n"
+      << "    multiple of 64) and write <basename>.manifest.json instead of one map\n"
+      << "  --threads: worker threads (default: hardware concurrency)\n"
+      << "  --container: also write base keys, codes, map, zone maps and stats\n"
+      << "    into one checksummed file\n"
+      << "  --pack-base: also write <basename>.packed, the keys frame-of-reference\n"
+      << "    bitpacked in 512-row blocks (query with run_query --packed)\n"
+      << "  --pax: also write <basename>.pax, each block of --block-rows rows\n"
+      << "    (a multiple of 64, default 4096) holding its codes then its keys\n"
+      << "    (query with run_query --pax)\n"
+      << "  str columns also write <basename>.dict and <basename>.ids.bin (the base\n"
+      << "  column for queries: u32 ids of the order-preserving dictionary)\n";
 }
 
 template <class T>
@@ -69,6 +100,28 @@ Args parse_args(int argc, char **argv) {
     } else if (token == "--unique-cutoff") {
       if (++i >= argc) throw std::runtime_error("--unique-cutoff requires a value");
       args.unique_cutoff = parse_number<size_t>(argv[i], "--unique-cutoff");
+    } else if (token == "--optimal") {
+      args.optimal = true;
+    } else if (token == "--workload") {
+      if (++i >= argc) throw std::runtime_error("--workload requires a value");
+      args.workload = argv[i];
+    } else if (token == "--partition-rows") {
+      if (++i >= argc) throw std::runtime_error("--partition-rows requires a value");
+      args.partition_rows = parse_number<uint64_t>(argv[i], "--partition-rows");
+    } else if (token == "--threads") {
+      if (++i >= argc) throw std::runtime_error("--threads requires a value");
+      args.threads = parse_number<unsigned>(argv[i], "--threads");
+    } else if (token == "--pack-base") {
+      args.pack_base = true;
+    } else if (token == "--pax") {
+      args.pax = true;
+    } else if (token == "--block-rows") {
+      if (++i >= argc) throw std::runtime_error("--block-rows requires a value");
+      args.block_rows = parse_number<uint64_t>(argv[i], "--block-rows");
+      if (args.block_rows % 64 != 0) throw std::runtime_error("--block-rows must be a multiple of 64");
+    } else if (token == "--container") {
+      if (++i >= argc) throw std::runtime_error("--container requires a value");
+      args.container = argv[i];
     } else if (token == "-h" || token == "--help") {
       usage();
       std::exit(0);
@@ -79,99 +132,173 @@ Args parse_args(int argc, char **argv) {
   if (args.in.empty() || args.out.empty() || args.dtype.empty()) {
     throw std::runtime_error("--in, --out, and --dtype are required");
   }
-  if (args.dtype != "u32" && args.dtype != "u64") {
-    throw std::runtime_error("dtype must be u32 or u64");
+  if (csketch::parse_dtype(args.dtype) == csketch::DType::STR && !args.workload.empty()) {
+    throw std::runtime_error("--workload is not supported for str columns");
+  }
+  if (!args.container.empty() && args.partition_rows) {
+    throw std::runtime_error("--container does not support --partition-rows");
+  }
+  if (args.pax && args.partition_rows) {
+    throw std::runtime_error("--pax does not support --partition-rows");
+  }
+  if (!args.workload.empty() && !args.optimal) {
+    throw std::runtime_error("--workload requires --optimal");
   }
   return args;
 }
 
+std::vector<uint64_t> read_workload(const std::string &path, csketch::DType dtype) {
+  std::ifstream in(path);
+  if (!in) {
+    throw std::runtime_error("cannot open workload file");
+  }
+  std::vector<uint64_t> out;
+  std::string tok;
+  while (in >> tok) {
+    out.push_back(csketch::parse_key(tok, dtype));
+  }
+  if (out.empty()) {
+    throw std::runtime_error("workload file has no query constants");
+  }
+  return out;
+}
+
 } // namespace
 
 int main(int argc, char **argv) {
   try {
     Args args = parse_args(argc, argv);
+    csketch::memory_policy().first_touch_threads =
+        args.threads ? args.threads : csketch::default_threads();
 
-    std::vector<uint64_t> base64;
-    if (args.dtype == "u32") {
-      auto v = csketch::read_binary<uint32_t>(args.in);
-      base64.assign(v.begin(), v.end());
+    const csketch::DType dtype = csketch::parse_dtype(args.dtype);
+    csketch::ColumnVector<uint64_t> base64;
+    std::vector<std::string> extra_outputs;
+    if (dtype == csketch::DType::STR) {
+      const csketch::StringColumn strs = csketch::read_strings(args.in);
+      const auto dict = csketch::StringDictionary::build(strs);
+      const std::vector<uint32_t> ids = dict.encode(strs);
+      extra_outputs = {args.out + ".dict", args.out + ".ids.bin"};
+      dict.save(extra_outputs[0]);
+      csketch::write_binary(extra_outputs[1], ids);
+      base64.assign(ids.begin(), ids.end());
     } else {
-      base64 = csketch::read_binary<uint64_t>(args.in);
+      base64 = csketch::read_column_keys(args.in, dtype);
     }
     const size_t N = base64.size();
     if (N == 0) {
       throw std::runtime_error("empty input column");
     }
 
-    auto art =
-        csketch::NumericCompressionMap::build(base64, args.codes, args.sample,
-                                              args.unique_cutoff);
-
-    const uint32_t total_codes = art.total_codes;
-    if (total_codes == 0) {
-      throw std::runtime_error("map produced zero codes");
-    }
-    if (total_codes > 65536) {
-      throw std::runtime_error("total codes exceed 16-bit storage limit");
-    }
-
-    uint32_t code_bits = (total_codes <= 256) ? 8u : 16u;
-
-    std::vector<uint8_t> codes8;
-    std::vector<uint16_t> codes16;
-    if (code_bits == 8) {
-      codes8.resize(N);
-    } else {
-      codes16.resize(N);
+    std::vector<uint64_t> workload;
+    if (!args.workload.empty()) {
+      workload = read_workload(args.workload, dtype);
     }
 
-    size_t boundary_hits = 0;
-    for (size_t i = 0; i < N; ++i) {
-      auto [code, boundary] =
-          csketch::NumericCompressionMap::code_of(art, base64[i]);
-      if (code_bits == 8) {
-        if (code >= 256) {
-          throw std::runtime_error("code does not fit in 8 bits");
-        }
-        codes8[i] = static_cast<uint8_t>(code);
-      } else {
-        codes16[i] = static_cast<uint16_t>(code);
-      }
-      if (boundary) {
-        ++boundary_hits;
-      }
-    }
+    auto build_map = [&](const auto &keys) {
+      return args.optimal
+                 ? csketch::NumericCompressionMap::build_optimal(
+                       keys, args.codes, args.sample, args.unique_cutoff, workload)
+                 : csketch::NumericCompressionMap::build(keys, args.codes, args.sample,
+                                                         args.unique_cutoff);
+    };
 
     std::string sketch_path = args.out;
     if (sketch_path.size() < 7 ||
         sketch_path.substr(sketch_path.size() - 7) != ".sketch") {
       sketch_path += ".sketch";
     }
-    std::ofstream sk(sketch_path, std::ios::binary);
-    if (!sk) {
-      throw std::runtime_error("cannot open output sketch");
+
+    if (args.partition_rows) {
+      auto [manifest, sketch] = csketch::build_partitioned(
+          base64, args.partition_rows, args.codes, args.dtype, build_map, args.threads);
+      csketch::save_sketch(sketch, sketch_path);
+      const std::string manifest_path = csketch::save_manifest(manifest, args.out);
+      size_t codes_used = 0;
+      for (const auto &part : manifest.parts) {
+        codes_used += part.map.art.total_codes;
+      }
+      std::cout << "encoded " << N << " values\n";
+      std::cout << "partitions=" << manifest.parts.size()
+                << ", partition_rows=" << manifest.partition_rows
+                << ", code_bits=" << manifest.code_bits
+                << ", avg_codes/partition=" << codes_used / manifest.parts.size()
+                << ", boundary_hits(sample-based)=" << sketch.boundary_hits << "\n";
+      std::cout << "wrote:\n  " << sketch_path << "\n  " << manifest_path << " (+"
+                << manifest.parts.size() << " partition maps)\n";
+      for (const auto &path : extra_outputs) {
+        std::cout << "  " << path << "\n";
+      }
+      return 0;
     }
-    if (code_bits == 8) {
-      sk.write(reinterpret_cast<const char *>(codes8.data()),
-               static_cast<std::streamsize>(codes8.size() * sizeof(uint8_t)));
+
+    auto art = build_map(base64);
+
+    const uint32_t total_codes = art.total_codes;
+    const csketch::EncodedSketch sketch = csketch::encode_sketch(art, base64, args.threads);
+    const csketch::CodeStats stats = csketch::code_stats(sketch, base64, dtype, args.threads);
+    const uint32_t code_bits = sketch.code_bits;
+    const std::vector<uint64_t> &code_rows = sketch.code_rows;
+    const size_t boundary_hits = sketch.boundary_hits;
+
+    // Expected base probes per query: rows sharing the code of a constant
+    // drawn from the workload (or the data itself), unless the code is exact.
+    double expected_probes = 0.0;
+    if (workload.empty()) {
+      for (size_t c = 0; c < total_codes; ++c) {
+        expected_probes += static_cast<double>(code_rows[c]) * code_rows[c];
+      }
+      for (uint64_t u : art.uniques) {
+        if (csketch::NumericCompressionMap::is_exact(art, u)) {
+          const double rows = static_cast<double>(
+              code_rows[csketch::NumericCompressionMap::code_of(art, u).first]);
+          expected_probes -= rows * rows;
+        }
+      }
+      expected_probes /= static_cast<double>(N);
     } else {
-      sk.write(reinterpret_cast<const char *>(codes16.data()),
-               static_cast<std::streamsize>(codes16.size() * sizeof(uint16_t)));
+      for (uint64_t q : workload) {
+        if (!csketch::NumericCompressionMap::is_exact(art, q)) {
+          expected_probes += code_rows[csketch::NumericCompressionMap::code_of(art, q).first];
+        }
+      }
+      expected_probes /= static_cast<double>(workload.size());
     }
 
+    csketch::save_sketch(sketch, sketch_path);
+
     std::string map_path = args.out;
     if (map_path.size() < 9 ||
         map_path.substr(map_path.size() - 9) != ".map.json") {
       map_path += ".map.json";
     }
-    csketch::save_map_json(art, map_path, args.dtype, code_bits);
+    csketch::save_map_json(art, map_path, args.dtype, code_bits, stats);
 
     std::cout << "encoded " << N << " values\n";
     std::cout << "total_codes=" << total_codes << ", code_bits=" << code_bits
               << ", uniques=" << art.uniques.size()
               << ", ranges=" << art.endpoints.size()
-              << ", boundary_hits(sample-based)=" << boundary_hits << "\n";
+              << ", boundary_hits(sample-based)=" << boundary_hits
+              << ", expected_probes/query=" << expected_probes << "\n";
     std::cout << "wrote:\n  " << sketch_path << "\n  " << map_path << "\n";
+    if (args.pack_base) {
+      const auto packed = csketch::PackedColumn::pack(base64);
+      packed.save(args.out + ".packed");
+      std::cout << "  " << args.out << ".packed (" << packed.bytes() << " bytes, "
+                << static_cast<double>(N * sizeof(uint64_t)) / static_cast<double>(packed.bytes())
+                << "x smaller than u64 keys)\n";
+    }
+    if (args.pax) {
+      csketch::write_blocked(args.out + ".pax", dtype, base64, sketch, args.block_rows);
+      std::cout << "  " << args.out << ".pax (" << args.block_rows << "-row blocks)\n";
+    }
+    if (!args.container.empty()) {
+      csketch::write_container(args.container, dtype, base64, art, sketch, 65536, stats);
+      std::cout << "  " << args.container << "\n";
+    }
+    for (const auto &path : extra_outputs) {
+      std::cout << "  " << path << "\n";
+    }
     return 0;
 
   } catch (const std::exception &e) {
@@ -0,0 +1,465 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "csketch/column.hpp"
+#include "csketch/memory.hpp"
+#include "csketch/parallel.hpp"
+
+namespace {
+
+// Synthetic columns for benchmarks. Every row's value is a pure function of
+// (seed, row): draws come from a counter-based RNG keyed by the seed and
+// counted by row, so output is identical for any --threads. The one
+// sequential shape (timeseries, a random walk) is summed in fixed 64Ki-row
+// chunks, which keeps it thread-count independent as well.
+
+enum class Dist { Uniform, Normal, Beta, HeavyHitter, Zipf, Sorted, Clustered, TimeSeries };
+
+Dist parse_dist(const std::string &s) {
+  if (s == "uniform") return Dist::Uniform;
+  if (s == "normal") return Dist::Normal;
+  if (s == "beta") return Dist::Beta;
+  if (s == "heavy-hitter") return Dist::HeavyHitter;
+  if (s == "zipf") return Dist::Zipf;
+  if (s == "sorted") return Dist::Sorted;
+  if (s == "clustered") return Dist::Clustered;
+  if (s == "timeseries") return Dist::TimeSeries;
+  throw std::runtime_error("unknown --dist: " + s);
+}
+
+struct Args {
+  uint64_t n = 0;
+  std::string dtype;
+  std::string dist = "uniform";
+  std::string out;
+  uint64_t seed = 1;
+  unsigned threads = 0;
+  std::string lo, hi;          // value range (default: dtype range, [0, 1] for floats)
+  double beta_a = 1.0;         // beta
+  double beta_b = 5.0;
+  double sigma = 0.125;        // normal: std dev as a fraction of [lo, hi]
+  std::string hh_value = "42"; // heavy-hitter
+  double hh_frac = 0.3;
+  double zipf_s = 1.1;         // zipf: exponent and number of ranks
+  uint64_t zipf_n = 1000000;
+  uint64_t clusters = 16;      // clustered
+  double cluster_width = 0.01;
+  double walk_step = 0.001;    // timeseries: step std dev as a fraction of [lo, hi]
+};
+
+void usage() {
+  std::cerr
+      << "Usage: gen_data --n N --dtype <u32|u64|i32|i64|f32|f64> -o <column.bin>\n"
+      << "       [--dist D] [--seed S] [--threads N] [--lo X] [--hi Y]\n"
+      << "  --dist: uniform (default), normal [--sigma F], beta [--beta-a A --beta-b B],\n"
+      << "    heavy-hitter [--hh-value V --hh-frac F], zipf [--zipf-s S --zipf-n K],\n"
+      << "    sorted, clustered [--clusters C --cluster-width F], timeseries [--walk-step F]\n"
+      << "  --lo/--hi: value range (default: the dtype's range; [0, 1] for floats)\n"
+      << "  --seed: RNG seed (default 1); output does not depend on --threads\n"
+      << "  normal: mean mid-range, std dev F of the range (default 0.125), clamped\n"
+      << "  heavy-hitter: fraction F (default 0.3) of rows equal V (default 42), rest uniform\n"
+      << "  zipf: rank k in [1, K] with P(k) ~ k^-S (defaults 1.1, 1000000), written as lo + k - 1\n"
+      << "  sorted: uniform values in ascending row order\n"
+      << "  clustered: normal bumps of std dev F (default 0.01) around C random centers (default 16)\n"
+      << "  timeseries: random walk from mid-range, steps of std dev F (default 0.001),\n"
+      << "    reflected at lo/hi\n";
+}
+
+template <class T>
+T parse_number(const std::string &s, const char *label) {
+  size_t idx = 0;
+  T v{};
+  if constexpr (std::is_floating_point<T>::value) {
+    v = static_cast<T>(std::stod(s, &idx));
+  } else {
+    v = static_cast<T>(std::stoull(s, &idx, 10));
+  }
+  if (idx != s.size()) {
+    throw std::runtime_error(std::string("invalid numeric value for ") + label);
+  }
+  return v;
+}
+
+Args parse_args(int argc, char **argv) {
+  Args args;
+  for (int i = 1; i < argc; ++i) {
+    std::string token = argv[i];
+    auto need = [&](const char *flag) {
+      if (++i >= argc) throw std::runtime_error(std::string(flag) + " requires a value");
+      return std::string(argv[i]);
+    };
+    if (token == "--n") {
+      args.n = parse_number<uint64_t>(need("--n"), "--n");
+    } else if (token == "--dtype") {
+      args.dtype = need("--dtype");
+    } else if (token == "--dist") {
+      args.dist = need("--dist");
+    } else if (token == "-o" || token == "--out") {
+      args.out = need("--out");
+    } else if (token == "--seed") {
+      args.seed = parse_number<uint64_t>(need("--seed"), "--seed");
+    } else if (token == "--threads") {
+      args.threads = parse_number<unsigned>(need("--threads"), "--threads");
+    } else if (token == "--lo") {
+      args.lo = need("--lo");
+    } else if (token == "--hi") {
+      args.hi = need("--hi");
+    } else if (token == "--beta-a") {
+      args.beta_a = parse_number<double>(need("--beta-a"), "--beta-a");
+    } else if (token == "--beta-b") {
+      args.beta_b = parse_number<double>(need("--beta-b"), "--beta-b");
+    } else if (token == "--sigma") {
+      args.sigma = parse_number<double>(need("--sigma"), "--sigma");
+    } else if (token == "--hh-value") {
+      args.hh_value = need("--hh-value");
+    } else if (token == "--hh-frac") {
+      args.hh_frac = parse_number<double>(need("--hh-frac"), "--hh-frac");
+    } else if (token == "--zipf-s") {
+      args.zipf_s = parse_number<double>(need("--zipf-s"), "--zipf-s");
+    } else if (token == "--zipf-n") {
+      args.zipf_n = parse_number<uint64_t>(need("--zipf-n"), "--zipf-n");
+    } else if (token == "--clusters") {
+      args.clusters = parse_number<uint64_t>(need("--clusters"), "--clusters");
+    } else if (token == "--cluster-width") {
+      args.cluster_width = parse_number<double>(need("--cluster-width"), "--cluster-width");
+    } else if (token == "--walk-step") {
+      args.walk_step = parse_number<double>(need("--walk-step"), "--walk-step");
+    } else if (token == "-h" || token == "--help") {
+      usage();
+      std::exit(0);
+    } else {
+      throw std::runtime_error("unknown argument: " + token);
+    }
+  }
+  if (args.n == 0 || args.dtype.empty() || args.out.empty()) {
+    throw std::runtime_error("--n, --dtype and -o are required");
+  }
+  parse_dist(args.dist);
+  if (csketch::parse_dtype(args.dtype) == csketch::DType::STR) {
+    throw std::runtime_error("gen_data writes numeric columns only");
+  }
+  if (args.beta_a <= 0 || args.beta_b <= 0 || args.sigma <= 0 || args.zipf_s <= 0 ||
+      args.zipf_n == 0 || args.clusters == 0 || args.cluster_width <= 0 || args.walk_step <= 0) {
+    throw std::runtime_error("distribution parameters must be positive");
+  }
+  if (args.hh_frac < 0 || args.hh_frac > 1) {
+    throw std::runtime_error("--hh-frac must be in [0, 1]");
+  }
+  if (args.threads == 0) {
+    args.threads = csketch::default_threads();
+  }
+  return args;
+}
+
+// Philox4x32-10 (Salmon et al., SC'11): 128 random bits per (key, counter).
+std::array<uint32_t, 4> philox(std::array<uint32_t, 4> c, uint32_t k0, uint32_t k1) {
+  for (int r = 0; r < 10; ++r) {
+    const uint64_t p0 = uint64_t(0xD2511F53) * c[0];
+    const uint64_t p1 = uint64_t(0xCD9E8D57) * c[2];
+    c = {static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k0, static_cast<uint32_t>(p1),
+         static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k1, static_cast<uint32_t>(p0)};
+    k0 += 0x9E3779B9;
+    k1 += 0xBB67AE85;
+  }
+  return c;
+}
+
+// Draws for one row: counter = {row, draw index, stream}, key = seed.
+// Stream 0 is per-row data; stream 1 holds per-column constants (cluster
+// centers), indexed by the "row" slot.
+class RowRng {
+public:
+  RowRng(uint64_t seed, uint64_t row, uint32_t stream = 0) : seed_(seed), row_(row), stream_(stream) {}
+
+  uint64_t next() {
+    if (left_ == 0) {
+      const auto b = philox({static_cast<uint32_t>(row_), static_cast<uint32_t>(row_ >> 32), draw_++, stream_},
+                            static_cast<uint32_t>(seed_), static_cast<uint32_t>(seed_ >> 32));
+      buf_[0] = uint64_t(b[0]) | uint64_t(b[1]) << 32;
+      buf_[1] = uint64_t(b[2]) | uint64_t(b[3]) << 32;
+      left_ = 2;
+    }
+    return buf_[2 - left_--];
+  }
+
+  // Uniform on the open interval (0, 1).
+  double uniform() { return (static_cast<double>(next() >> 11) + 0.5) * 0x1.0p-53; }
+
+  double normal() {
+    const double u1 = uniform(), u2 = uniform();
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+  }
+
+  // Marsaglia-Tsang; shapes below 1 are boosted by U^(1/a).
+  double gamma(double a) {
+    if (a < 1.0) {
+      return gamma(a + 1.0) * std::pow(uniform(), 1.0 / a);
+    }
+    const double d = a - 1.0 / 3.0, c = 1.0 / std::sqrt(9.0 * d);
+    for (;;) {
+      const double x = normal();
+      double v = 1.0 + c * x;
+      if (v <= 0.0) {
+        continue;
+      }
+      v = v * v * v;
+      if (std::log(uniform()) < 0.5 * x * x + d - d * v + d * std::log(v)) {
+        return d * v;
+      }
+    }
+  }
+
+  double beta(double a, double b) {
+    const double x = gamma(a);
+    return x / (x + gamma(b));
+  }
+
+private:
+  uint64_t seed_, row_;
+  uint32_t stream_;
+  uint32_t draw_ = 0;
+  uint64_t buf_[2] = {0, 0};
+  unsigned left_ = 0;
+};
+
+// Zipf ranks by rejection-inversion (Hormann & Derflinger, 1996): O(1)
+// expected draws per sample for any exponent and rank count.
+class ZipfSampler {
+public:
+  ZipfSampler(uint64_t n, double s) : n_(static_cast<double>(n)), s_(s) {
+    h_x1_ = h_integral(1.5) - 1.0;
+    h_n_ = h_integral(n_ + 0.5);
+    shift_ = 2.0 - h_integral_inv(h_integral(2.5) - h(2.0));
+  }
+
+  uint64_t sample(RowRng &rng) const {
+    for (;;) {
+      const double u = h_n_ + rng.uniform() * (h_x1_ - h_n_);
+      const double x = h_integral_inv(u);
+      const double k = std::min(std::max(std::floor(x + 0.5), 1.0), n_);
+      if (k - x <= shift_ || u >= h_integral(k + 0.5) - h(k)) {
+        return static_cast<uint64_t>(k);
+      }
+    }
+  }
+
+private:
+  static double helper1(double x) { return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x)); }
+  static double helper2(double x) { return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x)); }
+  double h(double x) const { return std::exp(-s_ * std::log(x)); }
+  double h_integral(double x) const {
+    const double lx = std::log(x);
+    return helper2((1.0 - s_) * lx) * lx;
+  }
+  double h_integral_inv(double x) const {
+    const double t = std::max(x * (1.0 - s_), -1.0);
+    return std::exp(helper1(t) * x);
+  }
+
+  double n_, s_;
+  double h_x1_ = 0, h_n_ = 0, shift_ = 0;
+};
+
+// Maps unit samples and integer offsets onto [lo, hi] of T.
+template <class T>
+struct Range {
+  T lo, hi;
+
+  T at(double x) const { // x in [0, 1]
+    if constexpr (std::is_floating_point<T>::value) {
+      return static_cast<T>(static_cast<double>(lo) + x * (static_cast<double>(hi) - static_cast<double>(lo)));
+    } else {
+      const long double span = static_cast<long double>(hi) - static_cast<long double>(lo) + 1.0L;
+      const long double v = static_cast<long double>(lo) + std::floor(static_cast<long double>(x) * span);
+      return v >= static_cast<long double>(hi) ? hi : static_cast<T>(v);
+    }
+  }
+
+  T offset(uint64_t k) const { // lo + k, saturating at hi
+    if constexpr (std::is_floating_point<T>::value) {
+      return std::min(hi, static_cast<T>(static_cast<double>(lo) + static_cast<double>(k)));
+    } else {
+      const long double v = static_cast<long double>(lo) + static_cast<long double>(k);
+      return v >= static_cast<long double>(hi) ? hi : static_cast<T>(v);
+    }
+  }
+};
+
+template <class T>
+T parse_value(const std::string &s, csketch::DType dtype) {
+  return csketch::from_key<T>(csketch::parse_key(s, dtype));
+}
+
+double clamp_unit(double x) { return std::min(std::max(x, 0.0), 1.0); }
+
+// Fold x onto [0, 1] as a reflecting boundary would.
+double reflect_unit(double x) {
+  const double m = std::fmod(std::abs(x), 2.0);
+  return m <= 1.0 ? m : 2.0 - m;
+}
+
+constexpr uint64_t kChunkRows = uint64_t(1) << 16;       // RNG work unit; fixes timeseries sums
+constexpr uint64_t kBatchRows = kChunkRows * 64;         // rows per write (4Mi)
+
+template <class T>
+class Generator {
+public:
+  Generator(const Args &args, csketch::DType dtype)
+      : a_(args), dist_(parse_dist(args.dist)), zipf_(args.zipf_n, args.zipf_s) {
+    range_.lo = args.lo.empty() ? (std::is_floating_point<T>::value ? T(0) : std::numeric_limits<T>::lowest())
+                                : parse_value<T>(args.lo, dtype);
+    range_.hi = args.hi.empty() ? (std::is_floating_point<T>::value ? T(1) : std::numeric_limits<T>::max())
+                                : parse_value<T>(args.hi, dtype);
+    if (!(range_.lo <= range_.hi)) {
+      throw std::runtime_error("--lo must not exceed --hi");
+    }
+    hh_ = parse_value<T>(args.hh_value, dtype);
+    for (uint64_t k = 0; k < args.clusters; ++k) {
+      centers_.push_back(RowRng(args.seed, k, 1).uniform());
+    }
+  }
+
+  // Random-walk displacement over rows [begin, end) (timeseries only).
+  double walk_sum(uint64_t begin, uint64_t end) const {
+    double s = 0.0;
+    for (uint64_t i = begin; i < end; ++i) {
+      s += a_.walk_step * RowRng(a_.seed, i).normal();
+    }
+    return s;
+  }
+
+  // Rows [begin, end) into out; `walk` is the timeseries position before begin.
+  void fill(uint64_t begin, uint64_t end, double walk, T *out) const {
+    const double n = static_cast<double>(a_.n);
+    for (uint64_t i = begin; i < end; ++i) {
+      RowRng rng(a_.seed, i);
+      T v{};
+      switch (dist_) {
+      case Dist::Uniform: v = range_.at(rng.uniform()); break;
+      case Dist::Normal: v = range_.at(clamp_unit(0.5 + a_.sigma * rng.normal())); break;
+      case Dist::Beta: v = range_.at(rng.beta(a_.beta_a, a_.beta_b)); break;
+      case Dist::HeavyHitter: {
+        const double u = rng.uniform();
+        v = u < a_.hh_frac ? hh_ : range_.at(rng.uniform());
+        break;
+      }
+      case Dist::Zipf: v = range_.offset(zipf_.sample(rng) - 1); break;
+      case Dist::Sorted: v = range_.at((static_cast<double>(i) + rng.uniform()) / n); break;
+      case Dist::Clustered: {
+        const double c = centers_[static_cast<size_t>(rng.next() % centers_.size())];
+        v = range_.at(reflect_unit(c + a_.cluster_width * rng.normal()));
+        break;
+      }
+      case Dist::TimeSeries:
+        walk += a_.walk_step * rng.normal();
+        v = range_.at(reflect_unit(0.5 + walk));
+        break;
+      }
+      out[i - begin] = v;
+    }
+  }
+
+  bool sequential() const { return dist_ == Dist::TimeSeries; }
+
+private:
+  const Args &a_;
+  Dist dist_;
+  ZipfSampler zipf_;
+  Range<T> range_{};
+  T hh_{};
+  std::vector<double> centers_;
+};
+
+// Generate in batches of kBatchRows, split into chunks over the workers; a
+// batch is written while the next one is generated. Returns bytes written.
+template <class T>
+uint64_t generate(const Args &args, csketch::DType dtype) {
+  const Generator<T> gen(args, dtype);
+  std::ofstream out(args.out, std::ios::binary);
+  if (!out) {
+    throw std::runtime_error("cannot open output " + args.out);
+  }
+  std::array<csketch::ColumnVector<T>, 2> buf;
+  std::future<void> pending;
+  double walk = 0.0;
+  size_t which = 0;
+  for (uint64_t b0 = 0; b0 < args.n; b0 += kBatchRows) {
+    const uint64_t b1 = std::min(args.n, b0 + kBatchRows);
+    const size_t chunks = static_cast<size_t>((b1 - b0 + kChunkRows - 1) / kChunkRows);
+    auto chunk_begin = [&](size_t c) { return b0 + c * kChunkRows; };
+    auto chunk_end = [&](size_t c) { return std::min(b1, b0 + (c + 1) * kChunkRows); };
+
+    std::vector<double> start(chunks, 0.0);
+    if (gen.sequential()) {
+      csketch::parallel_for(chunks, args.threads, [&](size_t c) { start[c] = gen.walk_sum(chunk_begin(c), chunk_end(c)); });
+      for (size_t c = 0; c < chunks; ++c) {
+        const double s = start[c];
+        start[c] = walk;
+        walk += s;
+      }
+    }
+    csketch::ColumnVector<T> &v = buf[which];
+    csketch::resize_uninitialized(v, static_cast<size_t>(b1 - b0));
+    csketch::parallel_for(chunks, args.threads, [&](size_t c) {
+      gen.fill(chunk_begin(c), chunk_end(c), start[c], v.data() + (chunk_begin(c) - b0));
+    });
+    if (pending.valid()) {
+      pending.get();
+    }
+    pending = std::async(std::launch::async, [&out, &v] {
+      out.write(reinterpret_cast<const char *>(v.data()), static_cast<std::streamsize>(v.size() * sizeof(T)));
+    });
+    which ^= 1;
+  }
+  if (pending.valid()) {
+    pending.get();
+  }
+  if (!out) {
+    throw std::runtime_error("write failed: " + args.out);
+  }
+  return args.n * sizeof(T);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  try {
+    const Args args = parse_args(argc, argv);
+    csketch::memory_policy().first_touch_threads = args.threads;
+    const csketch::DType dtype = csketch::parse_dtype(args.dtype);
+
+    const auto t0 = std::chrono::steady_clock::now();
+    uint64_t bytes = 0;
+    switch (dtype) {
+    case csketch::DType::U32: bytes = generate<uint32_t>(args, dtype); break;
+    case csketch::DType::U64: bytes = generate<uint64_t>(args, dtype); break;
+    case csketch::DType::I32: bytes = generate<int32_t>(args, dtype); break;
+    case csketch::DType::I64: bytes = generate<int64_t>(args, dtype); break;
+    case csketch::DType::F32: bytes = generate<float>(args, dtype); break;
+    case csketch::DType::F64: bytes = generate<double>(args, dtype); break;
+    case csketch::DType::STR: break;
+    }
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    const double mb = static_cast<double>(bytes) / 1e6;
+    std::cout << "wrote " << args.n << " rows to " << args.out << " (dist=" << args.dist
+              << ", seed=" << args.seed << ") in " << secs << " s, " << mb / secs << " MB/s\n";
+    return 0;
+
+  } catch (const std::exception &e) {
+    std::cerr << "error: " << e.what() << "\n";
+    usage();
+    return 1;
+  }
+}
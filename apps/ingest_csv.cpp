@@ -0,0 +1,439 @@
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "csketch/column.hpp"
+#include "csketch/compression_map.hpp"
+#include "csketch/dictionary.hpp"
+#include "csketch/mmap_file.hpp"
+#include "csketch/parallel.hpp"
+#include "csketch/sketch.hpp"
+
+namespace {
+
+struct ColumnSpec {
+  std::string name;
+  csketch::DType dtype = csketch::DType::U64;
+  std::string out;
+  size_t field = 0; // index in the CSV header
+};
+
+struct Args {
+  std::string csv;
+  std::vector<ColumnSpec> cols;
+  unsigned threads = 0;
+  char delim = ',';
+  uint32_t sketch_codes = 0; // 0: no sketch
+  size_t sample = 10000;
+  size_t unique_cutoff = 1;
+  bool optimal = false;
+};
+
+void usage() {
+  std::cerr
+      << "Usage: ingest_csv --csv <file.csv> --col NAME:DTYPE:OUT [--col ...]\n"
+      << "       [--threads N] [--delim C]\n"
+      << "       [--sketch-codes N [--sample N] [--unique-cutoff N] [--optimal]]\n"
+      << "  DTYPE: u32|u64|i32|i64|f32|f64 (raw .bin) or str (.strs)\n"
+      << "  --threads: parser threads (default: hardware concurrency)\n"
+      << "  --sketch-codes: also build a sketch per column in the same pass; files\n"
+      << "    are named after OUT without its extension (.sketch, .map.json, and\n"
+      << "    .dict/.ids.bin for str)\n";
+}
+
+size_t parse_count(const std::string &s, const char *label) {
+  size_t idx = 0;
+  unsigned long long v = std::stoull(s, &idx, 10);
+  if (idx != s.size() || v == 0) {
+    throw std::runtime_error(std::string("invalid value for ") + label);
+  }
+  return static_cast<size_t>(v);
+}
+
+ColumnSpec parse_col(const std::string &s) {
+  const size_t a = s.find(':');
+  const size_t b = (a == std::string::npos) ? a : s.find(':', a + 1);
+  if (b == std::string::npos) {
+    throw std::runtime_error("--col expects NAME:DTYPE:OUT, got " + s);
+  }
+  ColumnSpec c;
+  c.name = s.substr(0, a);
+  c.dtype = csketch::parse_dtype(s.substr(a + 1, b - a - 1));
+  c.out = s.substr(b + 1);
+  if (c.name.empty() || c.out.empty()) {
+    throw std::runtime_error("--col expects NAME:DTYPE:OUT, got " + s);
+  }
+  return c;
+}
+
+Args parse_args(int argc, char **argv) {
+  Args args;
+  for (int i = 1; i < argc; ++i) {
+    std::string token = argv[i];
+    if (token == "--csv") {
+      if (++i >= argc) throw std::runtime_error("--csv requires a value");
+      args.csv = argv[i];
+    } else if (token == "--col") {
+      if (++i >= argc) throw std::runtime_error("--col requires a value");
+      args.cols.push_back(parse_col(argv[i]));
+    } else if (token == "--threads") {
+      if (++i >= argc) throw std::runtime_error("--threads requires a value");
+      args.threads = static_cast<unsigned>(parse_count(argv[i], "--threads"));
+    } else if (token == "--delim") {
+      if (++i >= argc) throw std::runtime_error("--delim requires a value");
+      if (std::string(argv[i]).size() != 1) throw std::runtime_error("--delim must be one character");
+      args.delim = argv[i][0];
+    } else if (token == "--sketch-codes") {
+      if (++i >= argc) throw std::runtime_error("--sketch-codes requires a value");
+      args.sketch_codes = static_cast<uint32_t>(parse_count(argv[i], "--sketch-codes"));
+    } else if (token == "--sample") {
+      if (++i >= argc) throw std::runtime_error("--sample requires a value");
+      args.sample = parse_count(argv[i], "--sample");
+    } else if (token == "--unique-cutoff") {
+      if (++i >= argc) throw std::runtime_error("--unique-cutoff requires a value");
+      args.unique_cutoff = parse_count(argv[i], "--unique-cutoff");
+    } else if (token == "--optimal") {
+      args.optimal = true;
+    } else if (token == "-h" || token == "--help") {
+      usage();
+      std::exit(0);
+    } else {
+      throw std::runtime_error("unknown argument: " + token);
+    }
+  }
+  if (args.csv.empty() || args.cols.empty()) {
+    throw std::runtime_error("--csv and at least one --col are required");
+  }
+  if (args.threads == 0) {
+    args.threads = csketch::default_threads();
+  }
+  return args;
+}
+
+// Split one CSV record starting at p into fields; returns the position just
+// past the record terminator. Quoted fields are unescaped into `scratch`.
+class RecordReader {
+public:
+  RecordReader(const char *end, char delim) : end_(end), delim_(delim) {}
+
+  const char *read(const char *p, std::vector<std::string_view> &fields,
+                   std::vector<std::string> &scratch) {
+    fields.clear();
+    size_t used = 0;
+    for (;;) {
+      if (p < end_ && *p == '"') {
+        if (used == scratch.size()) {
+          scratch.emplace_back();
+        }
+        std::string &buf = scratch[used++];
+        buf.clear();
+        ++p;
+        for (;;) {
+          if (p >= end_) {
+            throw std::runtime_error("unterminated quoted field");
+          }
+          if (*p == '"') {
+            if (p + 1 < end_ && p[1] == '"') {
+              buf.push_back('"');
+              p += 2;
+              continue;
+            }
+            ++p;
+            break;
+          }
+          buf.push_back(*p++);
+        }
+        fields.emplace_back(buf);
+        while (p < end_ && *p != delim_ && *p != '\n') {
+          ++p; // tolerate junk (e.g. \r) after the closing quote
+        }
+      } else {
+        const char *s = p;
+        while (p < end_ && *p != delim_ && *p != '\n') {
+          ++p;
+        }
+        const char *e = p;
+        if (e > s && e[-1] == '\r' && (p >= end_ || *p == '\n')) {
+          --e;
+        }
+        fields.emplace_back(s, static_cast<size_t>(e - s));
+      }
+      if (p >= end_) {
+        return p;
+      }
+      if (*p == '\n') {
+        return p + 1;
+      }
+      ++p; // delimiter
+    }
+  }
+
+private:
+  const char *end_;
+  char delim_;
+};
+
+uint64_t parse_field(std::string_view f, csketch::DType t) {
+  while (!f.empty() && (f.front() == ' ' || f.front() == '\t')) f.remove_prefix(1);
+  while (!f.empty() && (f.back() == ' ' || f.back() == '\t')) f.remove_suffix(1);
+  if (!f.empty() && f.front() == '+') f.remove_prefix(1);
+  const char *b = f.data();
+  const char *e = f.data() + f.size();
+  std::from_chars_result r{b, std::errc::invalid_argument};
+  uint64_t key = 0;
+  switch (t) {
+  case csketch::DType::U32: {
+    uint32_t v = 0;
+    r = std::from_chars(b, e, v);
+    key = csketch::to_key(v);
+    break;
+  }
+  case csketch::DType::U64: {
+    uint64_t v = 0;
+    r = std::from_chars(b, e, v);
+    key = csketch::to_key(v);
+    break;
+  }
+  case csketch::DType::I32: {
+    int32_t v = 0;
+    r = std::from_chars(b, e, v);
+    key = csketch::to_key(v);
+    break;
+  }
+  case csketch::DType::I64: {
+    int64_t v = 0;
+    r = std::from_chars(b, e, v);
+    key = csketch::to_key(v);
+    break;
+  }
+  case csketch::DType::F32: {
+    float v = 0;
+    r = std::from_chars(b, e, v);
+    key = csketch::to_key(v);
+    break;
+  }
+  case csketch::DType::F64: {
+    double v = 0;
+    r = std::from_chars(b, e, v);
+    key = csketch::to_key(v);
+    break;
+  }
+  case csketch::DType::STR:
+    break;
+  }
+  if (b == e || r.ec != std::errc() || r.ptr != e) {
+    throw std::runtime_error("invalid " + std::string(csketch::dtype_name(t)) + " value '" +
+                             std::string(f) + "'");
+  }
+  return key;
+}
+
+// Per-chunk parse output: numeric columns as order-preserving keys.
+struct ChunkOut {
+  std::vector<std::vector<uint64_t>> keys;
+  std::vector<csketch::StringColumn> strs;
+  size_t rows = 0;
+};
+
+std::string strip_extension(const std::string &path) {
+  const size_t slash = path.find_last_of('/');
+  const size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+    return path;
+  }
+  return path.substr(0, dot);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  try {
+    Args args = parse_args(argc, argv);
+
+    csketch::MappedFile file(args.csv);
+    file.advise_sequential();
+    const char *begin = reinterpret_cast<const char *>(file.data());
+    const char *end = begin + file.size();
+    if (file.size() == 0) {
+      throw std::runtime_error("empty csv");
+    }
+
+    // Header: resolve the requested column names to field indices.
+    RecordReader reader(end, args.delim);
+    std::vector<std::string_view> fields;
+    std::vector<std::string> scratch;
+    const char *body = reader.read(begin, fields, scratch);
+    std::vector<int> slot;
+    for (size_t c = 0; c < args.cols.size(); ++c) {
+      size_t f = 0;
+      while (f < fields.size() && fields[f] != args.cols[c].name) {
+        ++f;
+      }
+      if (f == fields.size()) {
+        throw std::runtime_error("column not found in header: " + args.cols[c].name);
+      }
+      args.cols[c].field = f;
+      if (slot.size() <= f) {
+        slot.resize(f + 1, -1);
+      }
+      if (slot[f] >= 0) {
+        throw std::runtime_error("column requested twice: " + args.cols[c].name);
+      }
+      slot[f] = static_cast<int>(c);
+    }
+    const size_t needed_fields = slot.size();
+
+    // Split the body into chunks on record boundaries. Pass 1 counts quotes
+    // per nominal chunk so each split point knows whether it starts inside a
+    // quoted field; the chunk then begins after the next unquoted newline.
+    const size_t body_bytes = static_cast<size_t>(end - body);
+    constexpr size_t kChunkBytes = size_t(8) << 20;
+    const size_t nchunks = std::max<size_t>(
+        1, std::min<size_t>(body_bytes / kChunkBytes + 1, size_t(args.threads) * 8));
+    std::vector<const char *> nominal(nchunks + 1);
+    for (size_t k = 0; k <= nchunks; ++k) {
+      nominal[k] = body + body_bytes * k / nchunks;
+    }
+    std::vector<uint8_t> parity(nchunks, 0);
+    csketch::parallel_for(nchunks, args.threads, [&](size_t k) {
+      size_t q = 0;
+      for (const char *p = nominal[k]; p < nominal[k + 1]; ++p) {
+        q += (*p == '"');
+      }
+      parity[k] = static_cast<uint8_t>(q & 1);
+    });
+    std::vector<const char *> start(nchunks + 1);
+    start[0] = body;
+    start[nchunks] = end;
+    {
+      uint8_t in_quote = parity[0];
+      for (size_t k = 1; k < nchunks; ++k) {
+        bool q = in_quote;
+        const char *p = nominal[k];
+        while (p < end && (q || *p != '\n')) {
+          q ^= (*p == '"');
+          ++p;
+        }
+        start[k] = std::max(start[k - 1], (p < end) ? p + 1 : end);
+        in_quote ^= parity[k];
+      }
+    }
+
+    // Pass 2: parse chunks in parallel.
+    std::vector<ChunkOut> chunks(nchunks);
+    csketch::parallel_for(nchunks, args.threads, [&](size_t k) {
+      ChunkOut &out = chunks[k];
+      out.keys.resize(args.cols.size());
+      out.strs.resize(args.cols.size());
+      std::vector<std::string_view> fv;
+      std::vector<std::string> sc;
+      const char *p = start[k];
+      const char *stop = start[k + 1];
+      while (p < stop) {
+        if (*p == '\n' || (*p == '\r' && p + 1 < end && p[1] == '\n')) {
+          p += (*p == '\r') ? 2 : 1; // blank line
+          continue;
+        }
+        p = reader.read(p, fv, sc);
+        if (fv.size() < needed_fields) {
+          throw std::runtime_error("chunk " + std::to_string(k) + ": record with " +
+                                   std::to_string(fv.size()) + " fields, need " +
+                                   std::to_string(needed_fields));
+        }
+        for (size_t c = 0; c < args.cols.size(); ++c) {
+          const ColumnSpec &col = args.cols[c];
+          if (col.dtype == csketch::DType::STR) {
+            out.strs[c].push_back(fv[col.field]);
+          } else {
+            try {
+              out.keys[c].push_back(parse_field(fv[col.field], col.dtype));
+            } catch (const std::exception &e) {
+              throw std::runtime_error("column " + col.name + ": " + e.what());
+            }
+          }
+        }
+        ++out.rows;
+      }
+    });
+
+    std::vector<size_t> row_base(nchunks + 1, 0);
+    for (size_t k = 0; k < nchunks; ++k) {
+      row_base[k + 1] = row_base[k] + chunks[k].rows;
+    }
+    const size_t N = row_base[nchunks];
+    std::cout << "parsed " << N << " rows in " << nchunks << " chunks\n";
+
+    for (size_t c = 0; c < args.cols.size(); ++c) {
+      const ColumnSpec &col = args.cols[c];
+      csketch::ColumnVector<uint64_t> keys;
+      std::vector<std::string> written{col.out};
+      const std::string stem = strip_extension(col.out);
+
+      if (col.dtype == csketch::DType::STR) {
+        csketch::StringColumn strs;
+        strs.offsets.reserve(N + 1);
+        for (auto &ch : chunks) {
+          const uint64_t shift = strs.bytes.size();
+          strs.bytes += ch.strs[c].bytes;
+          for (size_t i = 1; i < ch.strs[c].offsets.size(); ++i) {
+            strs.offsets.push_back(ch.strs[c].offsets[i] + shift);
+          }
+          ch.strs[c] = csketch::StringColumn();
+        }
+        csketch::write_strings(col.out, strs);
+        if (args.sketch_codes) {
+          const auto dict = csketch::StringDictionary::build(strs);
+          const std::vector<uint32_t> ids = dict.encode(strs);
+          dict.save(stem + ".dict");
+          csketch::write_binary(stem + ".ids.bin", ids);
+          written.push_back(stem + ".dict");
+          written.push_back(stem + ".ids.bin");
+          keys.assign(ids.begin(), ids.end());
+        }
+      } else {
+        csketch::resize_uninitialized(keys, N);
+        csketch::parallel_for(nchunks, args.threads, [&](size_t k) {
+          std::copy(chunks[k].keys[c].begin(), chunks[k].keys[c].end(),
+                    keys.begin() + static_cast<std::ptrdiff_t>(row_base[k]));
+          std::vector<uint64_t>().swap(chunks[k].keys[c]);
+        });
+        csketch::write_column_keys(col.out, keys, col.dtype);
+      }
+
+      if (args.sketch_codes) {
+        if (keys.empty()) {
+          throw std::runtime_error("cannot sketch empty column " + col.name);
+        }
+        auto art = args.optimal
+                       ? csketch::NumericCompressionMap::build_optimal(
+                             keys, args.sketch_codes, args.sample, args.unique_cutoff)
+                       : csketch::NumericCompressionMap::build(keys, args.sketch_codes,
+                                                               args.sample, args.unique_cutoff);
+        const csketch::EncodedSketch sketch = csketch::encode_sketch(art, keys, args.threads);
+        csketch::save_sketch(sketch, stem + ".sketch");
+        csketch::save_map_json(art, stem + ".map.json", csketch::dtype_name(col.dtype),
+                               sketch.code_bits);
+        written.push_back(stem + ".sketch");
+        written.push_back(stem + ".map.json");
+      }
+
+      std::cout << col.name << " (" << csketch::dtype_name(col.dtype) << "):";
+      for (const auto &path : written) {
+        std::cout << " " << path;
+      }
+      std::cout << "\n";
+    }
+    return 0;
+
+  } catch (const std::exception &e) {
+    std::cerr << "error: " << e.what() << "\n";
+    usage();
+    return 1;
+  }
+}
@@ -1,29 +1,70 @@
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
+#include "csketch/aggregate.hpp"
 #include "csketch/bitvector.hpp"
+#include "csketch/blocked.hpp"
 #include "csketch/column.hpp"
+#include "csketch/container.hpp"
+#include "csketch/dictionary.hpp"
+#include "csketch/partition.hpp"
+#include "csketch/project.hpp"
 #include "csketch/scan.hpp"
+#include "csketch/stream.hpp"
+#include "csketch/topk.hpp"
 
 using namespace csketch;
 
 struct Args {
-    std::string base_file;   // raw u32/u64
+    std::string base_file;   // raw u32/u64/i32/i64/f32/f64, or dictionary ids for str
+    std::string packed_file; // .packed FOR-bitpacked keys (instead of --base)
+    std::string pax_file;    // .pax blocked codes + keys (instead of --base/--sketch)
     std::string sketch_file; // .sketch (u8/u16)
     std::string map_json;    // .map.json
-    std::string dtype;       // u32/u64
-    std::string op;          // lt | eq | between
-    uint64_t v1 = 0, v2 = 0; // values
+    std::string manifest;    // .manifest.json (partitioned sketch, instead of --map)
+    std::string container;   // .csk (base, codes and map in one file)
+    std::string dtype;       // u32/u64/i32/i64/f32/f64/str
+    std::string dict_file;   // .dict (str only)
+    std::string op;          // lt | le | gt | ge | eq | ne | between | in | prefix (str only)
+    std::string v1, v2;      // values, parsed per dtype
     std::string out_mask;    // output bitvector (.bin)
+    std::string out_rowids;  // optional: matching row ids (u64 .bin)
+    std::string out_values;  // optional: matching values (column dtype .bin, or .strs for str)
+    std::string deleted;     // optional: tombstone bitvector (.bin); set rows never match
+    unsigned threads = 1;
+    std::string huge_pages = "thp"; // off | thp | explicit
+    std::string isa = "auto";       // scalar | sse4.2 | avx2 | avx512 | auto
+    bool verify = false;     // check container checksums on open
+    bool stream = false;     // scan chunks while later ones are read from disk
+    size_t chunk_rows = size_t(1) << 20;
+    bool approx = false;     // COUNT/SUM/AVG with bounds from codes + map stats only
+    std::string group_by;    // optional: per-code groups as CSV (codes + map stats only)
+    size_t top_k = 0;        // ORDER BY ... LIMIT K instead of a predicate
+    bool largest = false;    // top-k: largest keys first
 };
 
 static void usage() {
-    std::cerr << "\nUsage: run_query --base FILE --sketch FILE --map FILE --dtype {u32,u64} --op {lt,eq,between} --v1 X [--v2 Y] --out MASK.bin\n\n";
+    std::cerr << "\nUsage: run_query --base FILE --sketch FILE --map FILE --dtype {u32,u64,i32,i64,f32,f64} --op {lt,le,gt,ge,eq,ne,between,in} --v1 X [--v2 Y] --out MASK.bin\n"
+                 "                 (in: --v1 takes a comma-separated list, e.g. --v1 3,17,42)\n"
+                 "                 [--manifest FILE instead of --map] [--rowids IDS.bin] [--project VALUES.bin] [--threads N]\n"
+                 "                 [--huge-pages {off,thp,explicit}] [--stream [--chunk-rows N]]\n"
+                 "                 [--isa {scalar,sse4.2,avx2,avx512,auto}] [--deleted TOMBSTONES.bin]\n"
+                 "       run_query --packed FILE.packed ... (bitpacked keys from build_sketch --pack-base, instead of --base)\n"
+                 "       run_query --pax FILE.pax --map FILE ... (blocked codes + keys from build_sketch --pax, instead of --base/--sketch)\n"
+                 "       run_query --container FILE.csk [--verify] --op ... (replaces --base/--sketch/--map/--dtype)\n"
+                 "       run_query --sketch FILE --map FILE --dtype T [--approx --op ... --v1 X] [--group-by GROUPS.csv]\n"
+                 "                 (codes and map stats only: no --base, no --out)\n"
+                 "       run_query --base FILE --sketch FILE --map FILE --dtype T --top-k K [--largest] [--rowids IDS.bin] [--project VALUES.bin]\n"
+                 "                 (K smallest/largest values in order, instead of --op/--out; also with --container or --packed)\n"
+                 "       run_query --base IDS.bin --sketch FILE --map FILE --dtype str --dict FILE.dict --op {lt,eq,between,prefix} --v1 S [--v2 S] --out MASK.bin\n\n";
 }
 
 static Args parse(int argc, char** argv) {
@@ -32,19 +73,72 @@ static Args parse(int argc, char** argv) {
         std::string s = argv[i];
         auto need = [&](const char* f){ if (i+1>=argc) throw std::runtime_error(std::string("missing value for ")+f); return std::string(argv[++i]); };
         if (s=="--base") a.base_file = need("--base");
+        else if (s=="--packed") a.packed_file = need("--packed");
+        else if (s=="--pax") a.pax_file = need("--pax");
         else if (s=="--sketch") a.sketch_file = need("--sketch");
         else if (s=="--map") a.map_json = need("--map");
+        else if (s=="--manifest") a.manifest = need("--manifest");
+        else if (s=="--container") a.container = need("--container");
+        else if (s=="--verify") a.verify = true;
         else if (s=="--dtype") a.dtype = need("--dtype");
+        else if (s=="--dict") a.dict_file = need("--dict");
         else if (s=="--op") a.op = need("--op");
-        else if (s=="--v1") a.v1 = std::stoull(need("--v1"));
-        else if (s=="--v2") a.v2 = std::stoull(need("--v2"));
+        else if (s=="--v1") a.v1 = need("--v1");
+        else if (s=="--v2") a.v2 = need("--v2");
         else if (s=="--out") a.out_mask = need("--out");
+        else if (s=="--rowids") a.out_rowids = need("--rowids");
+        else if (s=="--project") a.out_values = need("--project");
+        else if (s=="--deleted") a.deleted = need("--deleted");
+        else if (s=="--threads") a.threads = static_cast<unsigned>(std::stoul(need("--threads")));
+        else if (s=="--huge-pages") a.huge_pages = need("--huge-pages");
+        else if (s=="--isa") a.isa = need("--isa");
+        else if (s=="--stream") a.stream = true;
+        else if (s=="--approx") a.approx = true;
+        else if (s=="--group-by") a.group_by = need("--group-by");
+        else if (s=="--top-k") {
+            a.top_k = static_cast<size_t>(std::stoull(need("--top-k")));
+            if (a.top_k == 0) throw std::runtime_error("--top-k must be positive");
+        }
+        else if (s=="--largest") a.largest = true;
+        else if (s=="--chunk-rows") a.chunk_rows = static_cast<size_t>(std::stoull(need("--chunk-rows")));
         else if (s=="-h"||s=="--help") { usage(); std::exit(0);} 
         else throw std::runtime_error("unknown arg: "+s);
     }
-    if (a.base_file.empty()||a.sketch_file.empty()||a.map_json.empty()||a.dtype.empty()||a.op.empty()||a.out_mask.empty())
+    if (a.approx || !a.group_by.empty()) {
+        if (a.approx && (a.op.empty()||a.v1.empty()))
+            throw std::runtime_error("--approx requires --op and --v1");
+        if (a.container.empty() && (a.sketch_file.empty()||a.map_json.empty()||a.dtype.empty()))
+            throw std::runtime_error("--approx/--group-by need --sketch, --map and --dtype (or --container)");
+        return a;
+    }
+    if (a.top_k) {
+        if (!a.op.empty()||!a.out_mask.empty()||!a.manifest.empty()||a.stream)
+            throw std::runtime_error("--top-k replaces --op/--out and does not support --manifest or --stream");
+    } else if (a.op.empty()||a.out_mask.empty()||a.v1.empty()) {
         throw std::runtime_error("required args missing");
-    if (a.op=="between" && a.v2==0 && a.v2<a.v1) std::swap(a.v1,a.v2);
+    }
+    if (a.largest && !a.top_k) throw std::runtime_error("--largest requires --top-k");
+    if (!a.deleted.empty() && (a.top_k||a.stream||!a.manifest.empty()))
+        throw std::runtime_error("--deleted does not support --top-k, --stream or --manifest");
+    if (!a.pax_file.empty()) {
+        if (!a.base_file.empty()||!a.sketch_file.empty()||!a.packed_file.empty()||!a.manifest.empty()||
+            !a.container.empty()||a.stream||a.top_k||a.map_json.empty())
+            throw std::runtime_error("--pax replaces --base/--sketch and needs --map (no --manifest/--container/--stream/--top-k)");
+        return a;
+    }
+    if (!a.packed_file.empty()) {
+        if (!a.base_file.empty()||!a.manifest.empty()||!a.container.empty()||a.stream)
+            throw std::runtime_error("--packed replaces --base and needs --map (no --manifest/--container/--stream)");
+        a.base_file = a.packed_file;
+    }
+    if (!a.container.empty()) {
+        if (!a.base_file.empty()||!a.sketch_file.empty()||!a.map_json.empty()||!a.manifest.empty())
+            throw std::runtime_error("--container replaces --base, --sketch, --map and --manifest");
+    } else if (a.base_file.empty()||a.sketch_file.empty()||(a.map_json.empty()==a.manifest.empty())||a.dtype.empty()) {
+        throw std::runtime_error("required args missing");
+    }
+    if (a.stream && (!a.manifest.empty() || !a.out_values.empty()))
+        throw std::runtime_error("--stream does not support --manifest or --project");
     return a;
 }
 
@@ -57,37 +151,218 @@ static std::vector<uint8_t> slurp(const std::string& path) {
     return buf;
 }
 
+static std::optional<QuerySpec> make_spec(const Args& args, DType dtype, StringDictionary& dict) {
+    if (dtype == DType::STR) {
+        if (args.dict_file.empty()) throw std::runtime_error("--dtype str requires --dict");
+        dict = StringDictionary::load(args.dict_file);
+        return translate_string_predicate(dict, parse_string_op(args.op), args.v1, args.v2);
+    }
+    return make_query(parse_query_op(args.op), args.v1, args.v2, dtype);
+}
+
+// --approx / --group-by: answer from a code histogram and the map's per-code
+// stats; the base column is never opened.
+static int run_approx(const Args& args) {
+    std::optional<ContainerView> C;
+    LoadedMap L;
+    std::vector<uint8_t> raw;
+    const void* codes = nullptr;
+    size_t n = 0;
+    if (!args.container.empty()) {
+        C.emplace(args.container, args.verify);
+        L = C->map();
+        codes = C->codes();
+        n = static_cast<size_t>(C->rows());
+    } else {
+        L = load_map_json(args.map_json);
+        raw = slurp(args.sketch_file);
+        codes = raw.data();
+        n = raw.size() / (L.code_bits / 8);
+    }
+    const DType dtype = parse_dtype(L.dtype);
+    const bool codes16 = (L.code_bits==16);
+    StringDictionary dict;
+    std::optional<QuerySpec> q;
+    if (!args.op.empty()) q = make_spec(args, dtype, dict);
+    const bool none = !args.op.empty() && !q; // string predicate that matches nothing
+
+    const std::vector<uint64_t> hist = code_histogram(codes, codes16, n, L.art.total_codes, args.threads);
+    std::cout << "rows=" << n << "\n" << std::setprecision(10);
+    if (args.approx) {
+        const ApproxAggregate r = none ? ApproxAggregate{} : approx_aggregate(L, hist, *q);
+        auto show = [](const char* name, const Estimate& e) {
+            std::cout << name << "~" << e.value << " [" << e.lo << ", " << e.hi << "]\n";
+        };
+        show("count", r.count);
+        show("sum", r.sum);
+        show("avg", r.avg);
+    }
+    if (!args.group_by.empty()) {
+        std::ofstream out(args.group_by);
+        if (!out) throw std::runtime_error("cannot open --group-by output");
+        out << std::setprecision(17) << "code,value_lo,value_hi,rows,rows_lo,rows_hi,sum,sum_lo,sum_hi\n";
+        const auto groups = none ? std::vector<CodeGroup>{} : approx_group_by(L, hist, q ? &*q : nullptr);
+        for (const CodeGroup& g : groups) {
+            out << g.code << "," << g.value_lo << "," << g.value_hi << ","
+                << g.rows.value << "," << g.rows.lo << "," << g.rows.hi << ","
+                << g.sum.value << "," << g.sum.lo << "," << g.sum.hi << "\n";
+        }
+        std::cout << "wrote " << groups.size() << " groups: " << args.group_by << "\n";
+    }
+    return 0;
+}
+
+// --top-k: threshold code from the code histogram (the map's row counts when
+// present), then one code pass; only the threshold bucket reads the base.
+static int run_top_k(const Args& args, const LoadedMap& L, const void* codes, bool codes16,
+                     const uint64_t* base, const PackedColumn* P, size_t n, DType dtype) {
+    const std::vector<uint64_t>* hist = L.stats.empty() ? nullptr : &L.stats.rows;
+    const TopK r = P ? top_k(L, codes, codes16, *P, n, args.top_k, args.largest, args.threads, hist)
+                     : top_k(L, codes, codes16, base, n, args.top_k, args.largest, args.threads, hist);
+    std::cout << "rows=" << n << ", top_k=" << r.rows.size() << ", threshold_code=" << r.threshold
+              << ", probed=" << r.probed << "\n";
+
+    StringDictionary dict;
+    if (dtype == DType::STR) {
+        if (args.dict_file.empty()) throw std::runtime_error("--dtype str requires --dict");
+        dict = StringDictionary::load(args.dict_file);
+    }
+    if (!args.out_rowids.empty()) {
+        write_binary(args.out_rowids, r.rows);
+        std::cout << "wrote row ids: " << args.out_rowids << "\n";
+    }
+    if (!args.out_values.empty()) {
+        if (dtype == DType::STR) {
+            StringColumn strs;
+            for (uint64_t id : r.keys) strs.push_back(dict.value(static_cast<uint32_t>(id)));
+            write_strings(args.out_values, strs);
+        } else {
+            write_column_keys(args.out_values, r.keys, dtype);
+        }
+        std::cout << "wrote values: " << args.out_values << "\n";
+    }
+    if (args.out_rowids.empty() && args.out_values.empty()) {
+        std::cout << std::setprecision(17);
+        for (size_t i = 0; i < r.rows.size(); ++i) {
+            std::cout << r.rows[i] << "\t";
+            if (dtype == DType::STR) std::cout << dict.value(static_cast<uint32_t>(r.keys[i])) << "\n";
+            else std::cout << key_value(r.keys[i], dtype) << "\n";
+        }
+    }
+    return 0;
+}
+
 int main(int argc, char** argv) {
     try {
         Args args = parse(argc, argv);
-        LoadedMap L = load_map_json(args.map_json);
-        if (args.dtype != L.dtype) std::cerr << "[warn] dtype mismatch: CLI=" << args.dtype << ", map=" << L.dtype << "\n";
+        memory_policy().huge_pages = parse_huge_pages(args.huge_pages);
+        isa_policy() = parse_isa(args.isa);
+        if (args.approx || !args.group_by.empty()) return run_approx(args);
+        memory_policy().first_touch_threads = args.threads ? args.threads : default_threads();
+        const bool partitioned = !args.manifest.empty();
+        Manifest M;
+        LoadedMap L;
+        std::optional<ContainerView> C;
+        std::optional<PackedColumn> P;
+        std::optional<BlockedView> X;
+        ColumnVector<uint64_t> base_keys;
+        std::vector<uint8_t> raw;
+        const uint64_t* base = nullptr;
+        const void* codes = nullptr;
+        size_t n = 0;
+        StreamInput S;
 
-        std::vector<uint64_t> base;
-        if (args.dtype=="u32") {
-            auto v = read_binary<uint32_t>(args.base_file); base.assign(v.begin(), v.end());
+        if (!args.pax_file.empty()) {
+            L = load_map_json(args.map_json);
+            X.emplace(args.pax_file);
+            if (args.dtype.empty()) args.dtype = dtype_name(X->dtype());
+            n = X->size();
+        } else if (!args.container.empty()) {
+            C.emplace(args.container, args.verify);
+            L = C->map();
+            if (args.dtype.empty()) args.dtype = L.dtype;
+            base = C->base();
+            codes = C->codes();
+            n = static_cast<size_t>(C->rows());
+            if (args.stream) S = stream_container(args.container, *C);
+        } else if (!args.packed_file.empty()) {
+            L = load_map_json(args.map_json);
+            P = PackedColumn::load(args.packed_file);
+            raw = slurp(args.sketch_file);
+            codes = raw.data();
+            n = P->size();
+            if (raw.size() != n * (L.code_bits / 8))
+                throw std::runtime_error("sketch length does not match base length");
+        } else if (args.stream) {
+            L = load_map_json(args.map_json);
+            S = stream_files(args.sketch_file, args.base_file, parse_dtype(args.dtype), L.code_bits);
+            n = static_cast<size_t>(S.rows);
         } else {
-            base = read_binary<uint64_t>(args.base_file);
+            if (partitioned) {
+                M = load_manifest(args.manifest);
+                L.dtype = M.dtype;
+                L.code_bits = M.code_bits;
+            } else {
+                L = load_map_json(args.map_json);
+            }
+            base_keys = read_column_keys(args.base_file, parse_dtype(args.dtype));
+            raw = slurp(args.sketch_file);
+            base = base_keys.data();
+            codes = raw.data();
+            n = base_keys.size();
+            if (raw.size() != n * (L.code_bits / 8))
+                throw std::runtime_error("sketch length does not match base length");
         }
+        if (args.dtype != L.dtype) std::cerr << "[warn] dtype mismatch: CLI=" << args.dtype << ", map=" << L.dtype << "\n";
+
+        const DType dtype = parse_dtype(args.dtype);
+        const bool codes16 = (L.code_bits==16);
 
-        auto raw = slurp(args.sketch_file);
-        bool codes16 = (L.code_bits==16);
-        size_t n = base.size();
-        if ((!codes16 && raw.size()!=n*sizeof(uint8_t)) || (codes16 && raw.size()!=n*sizeof(uint16_t)))
-            throw std::runtime_error("sketch length does not match base length");
-        const void* codes = raw.data();
+        if (args.top_k) return run_top_k(args, L, codes, codes16, base, P ? &*P : nullptr, n, dtype);
 
-        QuerySpec q;
-        if (args.op=="lt") q = {QuerySpec::Op::LT, args.v1, 0};
-        else if (args.op=="eq") q = {QuerySpec::Op::EQ, args.v1, 0};
-        else if (args.op=="between") q = {QuerySpec::Op::BETWEEN, args.v1, args.v2};
-        else throw std::runtime_error("unknown --op");
+        StringDictionary dict;
+        const std::optional<QuerySpec> q = make_spec(args, dtype, dict);
 
-        BitVector mask = scan_predicate(L, codes, codes16, base, q);
+        std::optional<BitVector> deleted;
+        if (!args.deleted.empty()) deleted = BitVector::load(args.deleted);
+        const BitVector* dead = deleted ? &*deleted : nullptr;
+
+        // An untranslatable string predicate (e.g. absent value) matches nothing
+        BitVector mask = !q ? BitVector(n)
+            : args.stream ? scan_stream(L, S, *q, StreamOptions{args.chunk_rows, 4})
+            : X ? scan_blocked(L, *X, *q, args.threads, dead)
+            : P ? scan_predicate(L, codes, codes16, *P, *q, dead)
+            : partitioned ? scan_partitioned(M, codes, base, n, *q, args.threads)
+                          : scan_predicate(L, codes, codes16, base, n, *q, dead);
         mask.save(args.out_mask);
 
-        std::cout << "rows=" << base.size() << ", matches=" << mask.count() << "\n";
+        std::cout << "rows=" << n;
+        if (dead) std::cout << ", deleted=" << dead->count();
+        std::cout << ", matches=" << mask.count() << "\n";
         std::cout << "wrote mask: " << args.out_mask << "\n";
+
+        if (!args.out_rowids.empty()) {
+            write_binary(args.out_rowids, mask_positions(mask, args.threads));
+            std::cout << "wrote row ids: " << args.out_rowids << "\n";
+        }
+        if (!args.out_values.empty()) {
+            std::vector<uint64_t> vals;
+            if (P) {
+                for (uint64_t row : mask_positions(mask, args.threads)) vals.push_back((*P)[row]);
+            } else if (X) {
+                for (uint64_t row : mask_positions(mask, args.threads)) vals.push_back((*X)[row]);
+            } else {
+                vals = gather(mask, base, n, args.threads);
+            }
+            if (dtype == DType::STR) {
+                StringColumn strs;
+                for (uint64_t id : vals) strs.push_back(dict.value(static_cast<uint32_t>(id)));
+                write_strings(args.out_values, strs);
+            } else {
+                write_column_keys(args.out_values, vals, dtype);
+            }
+            std::cout << "wrote values: " << args.out_values << "\n";
+        }
         return 0;
     } catch (const std::exception& e) {
         std::cerr << "error: " << e.what() << "\n";
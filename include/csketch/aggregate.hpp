@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <stdexcept>
+#include <vector>
+
+#include "csketch/column.hpp"
+#include "csketch/compression_map.hpp"
+#include "csketch/memory.hpp"
+#include "csketch/parallel.hpp"
+#include "csketch/scan.hpp"
+
+namespace csketch {
+
+// ---------------------------------------------------------------------
+//  Approximate answers from codes alone. A code histogram of the rows in
+//  scope, the per-code stats saved with the map and the predicate's code
+//  classification give COUNT/SUM/AVG with guaranteed bounds: definite codes
+//  contribute exactly, boundary (candidate) codes contribute anywhere from
+//  none to all of their rows, with values limited to the part of the code's
+//  [min, max] the predicate admits. Estimates assume values are spread
+//  uniformly over that range. The base column is never read.
+// ---------------------------------------------------------------------
+
+struct Estimate {
+  double value = 0.0;
+  double lo = 0.0; // guaranteed lower bound
+  double hi = 0.0; // guaranteed upper bound
+};
+
+struct ApproxAggregate {
+  Estimate count;
+  Estimate sum;
+  Estimate avg; // bounds hold if any row matches; all zero when none can
+};
+
+struct CodeGroup {
+  uint32_t code = 0;
+  uint64_t min_key = 0; // key range of the rows in this code
+  uint64_t max_key = 0;
+  double value_lo = 0.0; // values a matching row in this code can take
+  double value_hi = 0.0;
+  Estimate rows;
+  Estimate sum;
+};
+
+namespace detail {
+
+// Four interleaved sub-histograms keep runs of equal codes from serialising
+// on one counter.
+template <class Code>
+void histogram_range(const Code *codes, size_t begin, size_t end, size_t total, uint64_t *h) {
+  std::vector<uint64_t> sub(4 * total, 0);
+  uint64_t *h0 = sub.data(), *h1 = h0 + total, *h2 = h1 + total, *h3 = h2 + total;
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    ++h0[codes[i]];
+    ++h1[codes[i + 1]];
+    ++h2[codes[i + 2]];
+    ++h3[codes[i + 3]];
+  }
+  for (; i < end; ++i) {
+    ++h0[codes[i]];
+  }
+  for (size_t c = 0; c < total; ++c) {
+    h[c] += h0[c] + h1[c] + h2[c] + h3[c];
+  }
+}
+
+} // namespace detail
+
+// Rows per code over codes[0, N). The full-column histogram equals
+// L.stats.rows, so callers holding stats may skip this pass.
+inline std::vector<uint64_t> code_histogram(const void *codes, bool codes16, size_t N,
+                                            uint32_t total_codes, unsigned threads = 1) {
+  const size_t total = codes16 ? std::max<size_t>(total_codes, 65536) : 256;
+  if (threads == 0) {
+    threads = default_threads();
+  }
+  const size_t tasks = std::max<size_t>(1, std::min<size_t>(threads, N / 65536 + 1));
+  std::vector<std::vector<uint64_t>> part(tasks);
+  parallel_for(tasks, static_cast<unsigned>(tasks), [&](size_t t) {
+    part[t].assign(total, 0);
+    const auto [begin, end] = worker_range(N, static_cast<unsigned>(tasks), static_cast<unsigned>(t));
+    if (codes16) {
+      detail::histogram_range(static_cast<const uint16_t *>(codes), begin, end, total, part[t].data());
+    } else {
+      detail::histogram_range(static_cast<const uint8_t *>(codes), begin, end, total, part[t].data());
+    }
+  });
+  std::vector<uint64_t> h(total_codes, 0);
+  for (const auto &p : part) {
+    for (size_t c = 0; c < total_codes; ++c) {
+      h[c] += p[c];
+    }
+  }
+  return h;
+}
+
+namespace detail {
+
+// Key interval [lo, hi] a predicate admits; false if it admits nothing. NE
+// admits everything here and IN the [first, last] of its sorted values; both
+// narrow per code below.
+inline bool key_interval(const QuerySpec &q, uint64_t &lo, uint64_t &hi) {
+  using Op = QuerySpec::Op;
+  lo = 0;
+  hi = std::numeric_limits<uint64_t>::max();
+  switch (q.op) {
+  case Op::LT: if (q.v1 == 0) return false; hi = q.v1 - 1; break;
+  case Op::LE: hi = q.v1; break;
+  case Op::GT: if (q.v1 == hi) return false; lo = q.v1 + 1; break;
+  case Op::GE: lo = q.v1; break;
+  case Op::EQ: lo = hi = q.v1; break;
+  case Op::BETWEEN: if (q.v2 < q.v1) return false; lo = q.v1; hi = q.v2; break;
+  case Op::IN:
+    if (q.values.empty()) return false;
+    lo = q.values.front();
+    hi = q.values.back();
+    break;
+  case Op::NE: break;
+  }
+  return true;
+}
+
+// Fill g for code c, fully matching (definite) or a boundary code of q; h
+// rows of the code are in scope. Returns false if no row can match.
+inline bool code_group(const CodeStats &st, DType dtype, uint32_t c, uint64_t h_rows, bool definite,
+                       const QuerySpec *q, uint64_t plo, uint64_t phi, CodeGroup &g) {
+  if (h_rows == 0 || st.rows[c] == 0) {
+    return false;
+  }
+  const double h = static_cast<double>(h_rows);
+  g.code = c;
+  g.min_key = st.min_key[c];
+  g.max_key = st.max_key[c];
+  const double mean = st.sum[c] / static_cast<double>(st.rows[c]);
+
+  if (definite) {
+    g.value_lo = key_value(g.min_key, dtype);
+    g.value_hi = key_value(g.max_key, dtype);
+    g.rows = {h, h, h};
+    g.sum = h_rows == st.rows[c] ? Estimate{st.sum[c], st.sum[c], st.sum[c]}
+                                 : Estimate{h * mean, h * g.value_lo, h * g.value_hi};
+    return true;
+  }
+
+  // Boundary: clip the code's key range to [ka, kb]; frac is the expected
+  // matching share, all means every row matches. Point predicates assume
+  // the code holds min(rows, key span) distinct values, one of them hit.
+  using Op = QuerySpec::Op;
+  const double span = static_cast<double>(g.max_key - g.min_key) + 1.0;
+  const double distinct = std::min(static_cast<double>(st.rows[c]), span);
+  uint64_t ka = std::max(g.min_key, plo), kb = std::min(g.max_key, phi);
+  if (ka > kb) {
+    return false;
+  }
+  double frac = (static_cast<double>(kb - ka) + 1.0) / span;
+  bool all = ka == g.min_key && kb == g.max_key;
+  if (q->op == Op::EQ) {
+    frac = all ? 1.0 : 1.0 / distinct;
+  } else if (q->op == Op::NE) {
+    if (g.min_key == q->v1 && g.max_key == q->v1) {
+      return false;
+    }
+    all = q->v1 < g.min_key || q->v1 > g.max_key;
+    frac = all ? 1.0 : 1.0 - 1.0 / distinct;
+  } else if (q->op == Op::IN) {
+    const auto first = std::lower_bound(q->values.begin(), q->values.end(), g.min_key);
+    const auto last = std::upper_bound(q->values.begin(), q->values.end(), g.max_key);
+    if (first == last) {
+      return false;
+    }
+    ka = *first;
+    kb = *(last - 1);
+    all = g.min_key == g.max_key;
+    frac = std::min(1.0, static_cast<double>(last - first) / distinct);
+  }
+  g.value_lo = key_value(ka, dtype);
+  g.value_hi = key_value(kb, dtype);
+  const double rows_lo = all ? h : 0.0;
+  g.rows = {all ? h : h * frac, rows_lo, h};
+  const double per_row = all ? mean : 0.5 * (g.value_lo + g.value_hi);
+  // k matching rows, rows_lo <= k <= h, each valued in [value_lo, value_hi].
+  g.sum = {g.rows.value * per_row, std::min(rows_lo * g.value_lo, h * g.value_lo),
+           std::max(rows_lo * g.value_hi, h * g.value_hi)};
+  return true;
+}
+
+inline const CodeStats &require_stats(const LoadedMap &L, const char *who) {
+  if (L.stats.empty()) {
+    throw std::runtime_error(std::string(who) + ": map has no per-code stats (rebuild it with build_sketch)");
+  }
+  return L.stats;
+}
+
+} // namespace detail
+
+// Group rows by code. With a predicate, rejected codes are dropped and
+// boundary codes carry row/sum bounds; without one every non-empty code is
+// returned with exact row counts.
+inline std::vector<CodeGroup> approx_group_by(const LoadedMap &L, const std::vector<uint64_t> &hist,
+                                              const QuerySpec *q = nullptr) {
+  const CodeStats &st = detail::require_stats(L, "approx_group_by");
+  if (hist.size() != st.size()) {
+    throw std::invalid_argument("approx_group_by: histogram does not match the map");
+  }
+  const DType dtype = parse_dtype(L.dtype);
+  std::vector<CodeGroup> out;
+  QuerySpec encodable;
+  if (q) {
+    encodable = *q;
+    if (!encodable_query(L.art, encodable)) {
+      return out;
+    }
+    q = &encodable;
+  }
+  uint64_t plo = 0, phi = 0;
+  if (q && !detail::key_interval(*q, plo, phi)) {
+    return out;
+  }
+  const std::vector<uint8_t> cls =
+      q ? classify_codes(L.art, *q) : std::vector<uint8_t>(hist.size(), kDefinite);
+  for (uint32_t c = 0; c < hist.size(); ++c) {
+    CodeGroup g;
+    if (cls[c] != kReject && detail::code_group(st, dtype, c, hist[c], cls[c] == kDefinite, q, plo, phi, g)) {
+      out.push_back(g);
+    }
+  }
+  return out;
+}
+
+// COUNT/SUM/AVG of the rows matching q among those counted in hist.
+inline ApproxAggregate approx_aggregate(const LoadedMap &L, const std::vector<uint64_t> &hist,
+                                        const QuerySpec &q) {
+  ApproxAggregate r;
+  double vmin = std::numeric_limits<double>::infinity();
+  double vmax = -vmin;
+  for (const CodeGroup &g : approx_group_by(L, hist, &q)) {
+    r.count.value += g.rows.value;
+    r.count.lo += g.rows.lo;
+    r.count.hi += g.rows.hi;
+    r.sum.value += g.sum.value;
+    r.sum.lo += g.sum.lo;
+    r.sum.hi += g.sum.hi;
+    vmin = std::min(vmin, g.value_lo);
+    vmax = std::max(vmax, g.value_hi);
+  }
+  if (r.count.hi > 0) {
+    const double est = r.count.value > 0 ? r.sum.value / r.count.value : 0.5 * (vmin + vmax);
+    r.avg = {std::min(std::max(est, vmin), vmax), vmin, vmax};
+  }
+  return r;
+}
+
+} // namespace csketch
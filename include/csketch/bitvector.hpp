@@ -4,8 +4,11 @@
 #include <fstream>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "csketch/memory.hpp"
+
 namespace csketch {
 
 class BitVector {
@@ -15,7 +18,9 @@ public:
 
   void resize(uint64_t nbits) {
     nbits_ = nbits;
-    words_.assign(words_for(nbits), 0);
+    ColumnVector<uint64_t> words;
+    resize_uninitialized(words, words_for(nbits)); // fresh, so zeroed but not yet touched
+    words_ = std::move(words);
   }
 
   uint64_t size() const { return nbits_; }
@@ -51,8 +56,8 @@ public:
     return c;
   }
 
-  const std::vector<uint64_t> &words() const { return words_; }
-  std::vector<uint64_t> &words() { return words_; }
+  const ColumnVector<uint64_t> &words() const { return words_; }
+  ColumnVector<uint64_t> &words() { return words_; }
 
   void save(const std::string &path) const {
     std::ofstream out(path, std::ios::binary);
@@ -104,7 +109,7 @@ private:
   }
 
   uint64_t nbits_ = 0;
-  std::vector<uint64_t> words_;
+  ColumnVector<uint64_t> words_;
 };
 
 } // namespace csketch
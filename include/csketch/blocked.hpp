@@ -0,0 +1,212 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "csketch/bitvector.hpp"
+#include "csketch/column.hpp"
+#include "csketch/memory.hpp"
+#include "csketch/parallel.hpp"
+#include "csketch/scan.hpp"
+#include "csketch/sketch.hpp"
+
+namespace csketch {
+
+// ---------------------------------------------------------------------
+//  PAX-style blocked column (.pax). Rows are cut into blocks of block_rows
+//  (a multiple of 64); each block holds its codes followed by its u64 base
+//  keys, so a boundary probe reads a few KiB past the codes just compared
+//  instead of a distant page of a separate base array. With the default
+//  4096 rows a block is 4-8 KiB of codes plus 32 KiB of keys, so once
+//  loaded onto huge pages a block's codes and keys almost always share one.
+//
+//  [ header | pad to 4 KiB ] [ block 0 ] [ block 1 ] ...
+//
+//  Blocks sit at a fixed stride; the last one is zero-padded. The map is
+//  kept in its .map.json. All integers are little-endian.
+// ---------------------------------------------------------------------
+
+constexpr uint64_t kBlockedRows = 4096;
+constexpr uint64_t kBlockedDataOffset = 4096;
+constexpr uint32_t kBlockedVersion = 1;
+constexpr char kBlockedMagic[8] = {'C', 'S', 'K', 'P', 'A', 'X', '1', '\0'};
+
+struct BlockedHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t code_bits; // 8 or 16
+  uint64_t rows;
+  uint64_t block_rows;
+  uint32_t dtype; // DType
+  uint32_t pad;
+  uint64_t reserved[3];
+};
+static_assert(sizeof(BlockedHeader) == 64, "blocked header is 64 bytes");
+
+inline void write_blocked(const std::string &path, DType dtype, const ColumnVector<uint64_t> &keys,
+                          const EncodedSketch &sk, uint64_t block_rows = kBlockedRows) {
+  if (keys.size() != sk.size()) {
+    throw std::invalid_argument("write_blocked: codes and base lengths differ");
+  }
+  if (keys.empty()) {
+    throw std::invalid_argument("write_blocked: empty column");
+  }
+  if (block_rows == 0 || block_rows % 64 != 0) {
+    throw std::invalid_argument("write_blocked: block_rows must be a positive multiple of 64");
+  }
+  BlockedHeader hdr{};
+  std::memcpy(hdr.magic, kBlockedMagic, sizeof(hdr.magic));
+  hdr.version = kBlockedVersion;
+  hdr.code_bits = sk.code_bits;
+  hdr.rows = keys.size();
+  hdr.block_rows = block_rows;
+  hdr.dtype = static_cast<uint32_t>(dtype);
+
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    throw std::runtime_error("write_blocked: cannot open file");
+  }
+  std::vector<char> page(kBlockedDataOffset, 0);
+  std::memcpy(page.data(), &hdr, sizeof(hdr));
+  out.write(page.data(), static_cast<std::streamsize>(page.size()));
+
+  const size_t code_bytes = sk.code_bits / 8;
+  const uint8_t *codes = static_cast<const uint8_t *>(sk.data());
+  std::vector<char> block(block_rows * (code_bytes + sizeof(uint64_t)));
+  const size_t n = keys.size();
+  for (size_t begin = 0; begin < n; begin += block_rows) {
+    const size_t rows = std::min<size_t>(block_rows, n - begin);
+    std::fill(block.begin(), block.end(), 0);
+    std::memcpy(block.data(), codes + begin * code_bytes, rows * code_bytes);
+    std::memcpy(block.data() + block_rows * code_bytes, keys.data() + begin, rows * sizeof(uint64_t));
+    out.write(block.data(), static_cast<std::streamsize>(block.size()));
+  }
+  if (!out) {
+    throw std::runtime_error("write_blocked: write failed");
+  }
+}
+
+// A .pax file loaded into column memory (huge pages per memory_policy(),
+// so the interleaved blocks do not cost a TLB entry per 4 KiB). Indexing by
+// row returns its key, so the view also serves as a Base for gathers.
+class BlockedView {
+public:
+  explicit BlockedView(const std::string &path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+      throw std::runtime_error("BlockedView: cannot open " + path);
+    }
+    const uint64_t file_bytes = static_cast<uint64_t>(in.tellg());
+    if (file_bytes < kBlockedDataOffset) {
+      throw std::runtime_error("BlockedView: file too small");
+    }
+    in.seekg(0);
+    in.read(reinterpret_cast<char *>(&hdr_), sizeof(hdr_));
+    if (std::memcmp(hdr_.magic, kBlockedMagic, sizeof(hdr_.magic)) != 0) {
+      throw std::runtime_error("BlockedView: bad magic");
+    }
+    if (hdr_.version != kBlockedVersion) {
+      throw std::runtime_error("BlockedView: unsupported version");
+    }
+    if (hdr_.code_bits != 8 && hdr_.code_bits != 16) {
+      throw std::runtime_error("BlockedView: bad code width");
+    }
+    if (hdr_.block_rows == 0 || hdr_.block_rows % 64 != 0) {
+      throw std::runtime_error("BlockedView: bad block size");
+    }
+    code_bytes_ = hdr_.block_rows * (hdr_.code_bits / 8);
+    stride_ = code_bytes_ + hdr_.block_rows * sizeof(uint64_t);
+    const uint64_t bytes = file_bytes - kBlockedDataOffset;
+    if (bytes / stride_ < blocks() || bytes != blocks() * stride_) {
+      throw std::runtime_error("BlockedView: size does not match rows");
+    }
+    resize_uninitialized(data_, bytes / sizeof(uint64_t));
+    in.seekg(static_cast<std::streamoff>(kBlockedDataOffset));
+    in.read(reinterpret_cast<char *>(data_.data()), static_cast<std::streamsize>(bytes));
+    if (!in) {
+      throw std::runtime_error("BlockedView: truncated file");
+    }
+  }
+
+  uint64_t rows() const { return hdr_.rows; }
+  DType dtype() const { return static_cast<DType>(hdr_.dtype); }
+  uint32_t code_bits() const { return hdr_.code_bits; }
+  uint64_t block_rows() const { return hdr_.block_rows; }
+  uint64_t blocks() const { return (hdr_.rows + hdr_.block_rows - 1) / hdr_.block_rows; }
+
+  // Rows in block b (only the last block may be short).
+  size_t rows_in(uint64_t b) const {
+    return static_cast<size_t>(std::min<uint64_t>(hdr_.block_rows, hdr_.rows - b * hdr_.block_rows));
+  }
+  const void *codes(uint64_t b) const { return bytes() + b * stride_; }
+  const uint64_t *base(uint64_t b) const {
+    return reinterpret_cast<const uint64_t *>(bytes() + b * stride_ + code_bytes_);
+  }
+
+  uint64_t operator[](size_t i) const { return base(i / hdr_.block_rows)[i % hdr_.block_rows]; }
+  size_t size() const { return static_cast<size_t>(hdr_.rows); }
+
+private:
+  const uint8_t *bytes() const { return reinterpret_cast<const uint8_t *>(data_.data()); }
+
+  ColumnVector<uint64_t> data_; // the blocks; strides are multiples of 8 bytes
+  BlockedHeader hdr_{};
+  uint64_t code_bytes_ = 0;
+  uint64_t stride_ = 0;
+};
+
+// scan_predicate over a blocked column: each block runs the same kernels on
+// its own codes and probes its own keys. Blocks are word-aligned in the
+// output mask, so they are split over `threads` workers without merging.
+// Rows set in the optional `deleted` bitmap never match.
+inline BitVector scan_blocked(const LoadedMap &L, const BlockedView &v, const QuerySpec &query,
+                              unsigned threads = 1, const BitVector *deleted = nullptr) {
+  if (L.code_bits != v.code_bits()) {
+    throw std::invalid_argument("scan_blocked: map and blocked column code widths differ");
+  }
+  if (deleted && deleted->size() != v.size()) {
+    throw std::invalid_argument("scan_blocked: tombstone bitmap length differs from column");
+  }
+  const uint64_t *dead = deleted ? deleted->words().data() : nullptr;
+  const bool codes16 = v.code_bits() == 16;
+  BitVector out(v.size());
+  QuerySpec q = query;
+  if (!encodable_query(L.art, q)) {
+    return out;
+  }
+  uint64_t *W = out.words().data();
+  const uint64_t block_words = v.block_rows() >> 6;
+  const uint64_t blocks = v.blocks();
+  const size_t tasks = std::min<size_t>(blocks, size_t(threads ? threads : default_threads()) * 4);
+  auto per_task = [&](auto &&scan_block) {
+    parallel_for(tasks, threads, [&](size_t t) {
+      for (uint64_t b = t * blocks / tasks; b < (t + 1) * blocks / tasks; ++b) {
+        scan_block(b, W + b * block_words, dead ? dead + b * block_words : nullptr);
+      }
+    });
+  };
+
+  if (q.op == QuerySpec::Op::IN) {
+    const std::vector<uint8_t> cls = classify_codes(L.art, q);
+    per_task([&](uint64_t b, uint64_t *Wb, const uint64_t *dead_b) {
+      detail::classified_scan(cls, v.codes(b), codes16, v.base(b), v.rows_in(b), q, Wb, dead_b);
+    });
+    return out;
+  }
+  RangeArgs a;
+  const Probe probe = range_args(L.art, q, a);
+  const RangeKernel<const uint64_t *> kernel = range_kernel<const uint64_t *>(active_isa(), codes16, q.op, probe);
+  per_task([&](uint64_t b, uint64_t *Wb, const uint64_t *dead_b) {
+    RangeArgs ab = a;
+    ab.dead = dead_b;
+    kernel(v.codes(b), v.base(b), v.rows_in(b), ab, Wb);
+  });
+  return out;
+}
+
+} // namespace csketch
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CSKETCH_CRC32C_HW 1
+#endif
+
+namespace csketch {
+
+// CRC-32C (Castagnoli). Uses the SSE4.2 crc32 instruction when the CPU has
+// it, otherwise a byte-wise table.
+
+namespace detail {
+
+inline const std::array<uint32_t, 256> &crc32c_table() {
+  static const std::array<uint32_t, 256> table = [] {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : (c >> 1);
+      }
+      t[i] = c;
+    }
+    return t;
+  }();
+  return table;
+}
+
+inline uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t n) {
+  const auto &t = crc32c_table();
+  for (size_t i = 0; i < n; ++i) {
+    crc = t[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if defined(CSKETCH_CRC32C_HW)
+__attribute__((target("sse4.2"))) inline uint32_t crc32c_hw(uint32_t crc, const uint8_t *p,
+                                                             size_t n) {
+  uint64_t c = crc;
+  while (n >= 8) {
+    uint64_t w;
+    std::memcpy(&w, p, 8);
+    c = _mm_crc32_u64(c, w);
+    p += 8;
+    n -= 8;
+  }
+  uint32_t c32 = static_cast<uint32_t>(c);
+  while (n--) {
+    c32 = _mm_crc32_u8(c32, *p++);
+  }
+  return c32;
+}
+#endif
+
+} // namespace detail
+
+inline uint32_t crc32c(const void *data, size_t n, uint32_t seed = 0) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  uint32_t crc = ~seed;
+#if defined(CSKETCH_CRC32C_HW)
+  static const bool hw = __builtin_cpu_supports("sse4.2");
+  crc = hw ? detail::crc32c_hw(crc, p, n) : detail::crc32c_sw(crc, p, n);
+#else
+  crc = detail::crc32c_sw(crc, p, n);
+#endif
+  return ~crc;
+}
+
+} // namespace csketch
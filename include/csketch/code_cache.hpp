@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "csketch/bitvector.hpp"
+#include "csketch/compression_map.hpp"
+#include "csketch/scan.hpp"
+
+namespace csketch {
+
+// ---------------------------------------------------------------------
+//  Code-range result cache. The sketch-level part of a predicate depends
+//  only on its code interval, so it is assembled from two kinds of cached
+//  pieces per column:
+//    prefix(c)  mask of rows with code < c
+//    rows(c)    mask of rows with code == c (the boundary bucket to probe)
+//  LT/LE are prefix(c1) plus probes of rows(c1); GT/GE are the complement
+//  of prefix(c1 + 1) plus probes of rows(c1); BETWEEN is
+//  prefix(c2) & ~prefix(c1 + 1) plus probes of rows(c1) and rows(c2); EQ is
+//  rows(c1), probed, and NE its complement; IN probes rows(c) of each
+//  distinct code in the list. An exact constant owns its code, so it needs
+//  no probes: EQ copies rows(c1), LT is prefix(c1), GT the complement of
+//  prefix(c1 + 1) and IN takes its bucket whole. Entries are evicted LRU
+//  once their total size passes the byte budget.
+// ---------------------------------------------------------------------
+
+class CodeRangeCache {
+public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t bytes = 0;
+    size_t entries = 0;
+  };
+
+  explicit CodeRangeCache(size_t budget_bytes = size_t(256) << 20) : budget_(budget_bytes) {}
+
+  // `column` identifies the code array (e.g. its path); callers must use a
+  // new name if the codes change.
+  template <class Base>
+  BitVector scan(const std::string &column, const LoadedMap &L, const void *codes, bool codes16,
+                 const Base &base, size_t N, const QuerySpec &query) {
+    using Op = QuerySpec::Op;
+    const Source src{column, codes, codes16, N};
+    BitVector out(N);
+    uint64_t *W = out.words().data();
+    QuerySpec q = query;
+    if (!encodable_query(L.art, q)) {
+      return out;
+    }
+
+    // Rows of bucket c whose key passes `keep` are set (or cleared).
+    auto probe = [&](uint32_t c, bool set, auto keep) {
+      const auto bucket = get(src, Kind::Rows, c);
+      const uint64_t *B = bucket->mask.words().data();
+      for (size_t w = 0; w < out.words().size(); ++w) {
+        uint64_t hits = 0;
+        for (uint64_t m = B[w]; m; m &= m - 1) {
+          const size_t j = static_cast<size_t>(__builtin_ctzll(m));
+          if (keep(base[(w << 6) + j])) {
+            hits |= 1ULL << j;
+          }
+        }
+        W[w] = set ? W[w] | hits : W[w] & ~hits;
+      }
+    };
+    // Rows with code >= c: the complement of prefix(c), tail bits cleared.
+    auto suffix = [&](uint32_t c) {
+      if (c == 0) {
+        std::fill(out.words().begin(), out.words().end(), ~0ULL);
+      } else {
+        const uint64_t *P = get(src, Kind::Prefix, c)->mask.words().data();
+        for (size_t w = 0; w < out.words().size(); ++w) {
+          W[w] = ~P[w];
+        }
+      }
+      if (N & 63) {
+        W[out.words().size() - 1] &= (1ULL << (N & 63)) - 1;
+      }
+    };
+
+    // Rows of bucket c, all matching: an exact constant owns its code.
+    auto bucket = [&](uint32_t c) {
+      const uint64_t *B = get(src, Kind::Rows, c)->mask.words().data();
+      for (size_t w = 0; w < out.words().size(); ++w) {
+        W[w] |= B[w];
+      }
+    };
+
+    if (q.op == Op::IN) {
+      // Buckets of exact values are taken whole; every other distinct bucket
+      // of the list is probed once against the whole list.
+      std::vector<uint32_t> buckets;
+      for (uint64_t v : q.values) {
+        const uint32_t c = NumericCompressionMap::code_of(L.art, v).first;
+        if (NumericCompressionMap::is_exact(L.art, v)) {
+          bucket(c);
+        } else {
+          buckets.push_back(c);
+        }
+      }
+      buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+      for (uint32_t c : buckets) {
+        probe(c, true, [&](uint64_t k) { return std::binary_search(q.values.begin(), q.values.end(), k); });
+      }
+      return out;
+    }
+
+    const uint32_t c1 = NumericCompressionMap::code_of(L.art, q.v1).first;
+    const uint64_t v1 = q.v1;
+    if (NumericCompressionMap::is_exact(L.art, v1)) {
+      // No probes: bucket c1 holds exactly the rows equal to v1.
+      switch (q.op) {
+      case Op::EQ: bucket(c1); return out;
+      case Op::NE:
+        bucket(c1);
+        for (uint64_t &w : out.words()) {
+          w = ~w;
+        }
+        if (N & 63) {
+          W[out.words().size() - 1] &= (1ULL << (N & 63)) - 1;
+        }
+        return out;
+      case Op::LT: return get(src, Kind::Prefix, c1)->mask;
+      case Op::LE: return get(src, Kind::Prefix, c1 + 1)->mask;
+      case Op::GT: suffix(c1 + 1); return out;
+      case Op::GE: suffix(c1); return out;
+      default: break;
+      }
+    }
+    switch (q.op) {
+    case Op::EQ:
+    case Op::NE: {
+      const bool eq = q.op == Op::EQ;
+      if (!eq) {
+        suffix(0);
+      }
+      probe(c1, eq, [&](uint64_t k) { return k == v1; });
+      return out;
+    }
+    case Op::LT:
+    case Op::LE:
+      out = get(src, Kind::Prefix, c1)->mask;
+      W = out.words().data();
+      if (q.op == Op::LT) {
+        probe(c1, true, [&](uint64_t k) { return k < v1; });
+      } else {
+        probe(c1, true, [&](uint64_t k) { return k <= v1; });
+      }
+      return out;
+    case Op::GT:
+    case Op::GE:
+      // Codes above c1 are definite: the complement of prefix(c1 + 1).
+      suffix(c1 + 1);
+      if (q.op == Op::GT) {
+        probe(c1, true, [&](uint64_t k) { return k > v1; });
+      } else {
+        probe(c1, true, [&](uint64_t k) { return k >= v1; });
+      }
+      return out;
+    default:
+      break;
+    }
+
+    // BETWEEN: codes strictly inside (c1, c2) are definite.
+    if (q.v2 < q.v1) {
+      return out;
+    }
+    const uint32_t c2 = NumericCompressionMap::code_of(L.art, q.v2).first;
+    if (c2 > c1 + 1) {
+      const auto hi = get(src, Kind::Prefix, c2);
+      const auto lo = get(src, Kind::Prefix, c1 + 1);
+      const uint64_t *H = hi->mask.words().data();
+      const uint64_t *Lw = lo->mask.words().data();
+      for (size_t w = 0; w < out.words().size(); ++w) {
+        W[w] = H[w] & ~Lw[w];
+      }
+    }
+    auto inside = [&](uint64_t k) { return k >= q.v1 && k <= q.v2; };
+    probe(c1, true, inside);
+    if (c2 != c1) {
+      probe(c2, true, inside);
+    }
+    return out;
+  }
+
+  Stats stats() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    Stats s = stats_;
+    s.bytes = bytes_;
+    s.entries = lru_.size();
+    return s;
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(mu_);
+    lru_.clear();
+    index_.clear();
+    bytes_ = 0;
+  }
+
+private:
+  enum class Kind : char { Prefix = 'p', Rows = 'r' };
+
+  struct Entry {
+    BitVector mask;
+    size_t bytes = 0;
+  };
+  using EntryPtr = std::shared_ptr<const Entry>;
+
+  struct Source {
+    const std::string &column;
+    const void *codes;
+    bool codes16;
+    size_t N;
+    uint32_t code_at(size_t i) const {
+      return codes16 ? static_cast<const uint16_t *>(codes)[i] : static_cast<const uint8_t *>(codes)[i];
+    }
+  };
+
+  static std::string key_of(const Source &src, Kind kind, uint32_t code) {
+    return src.column + '\0' + std::to_string(src.N) + static_cast<char>(kind) + std::to_string(code);
+  }
+
+  static EntryPtr build(const Source &src, Kind kind, uint32_t code) {
+    auto e = std::make_shared<Entry>();
+    e->mask = BitVector(src.N);
+    uint64_t *W = e->mask.words().data();
+    if (kind == Kind::Prefix) {
+      for (size_t i = 0; i < src.N; ++i) {
+        W[i >> 6] |= static_cast<uint64_t>(src.code_at(i) < code) << (i & 63);
+      }
+    } else {
+      // The EQ kernel without probes compares codes only; base is unused.
+      RangeArgs a;
+      a.c1 = code;
+      const uint64_t *no_base = nullptr;
+      range_kernel<const uint64_t *>(active_isa(), src.codes16, QuerySpec::Op::EQ, Probe::None)(
+          src.codes, no_base, src.N, a, W);
+    }
+    e->bytes = e->mask.words().size() * sizeof(uint64_t);
+    return e;
+  }
+
+  EntryPtr get(const Source &src, Kind kind, uint32_t code) {
+    const std::string key = key_of(src, kind, code);
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      auto it = index_.find(key);
+      if (it != index_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        ++stats_.hits;
+        return it->second->second;
+      }
+      ++stats_.misses;
+    }
+    EntryPtr e = build(src, kind, code); // outside the lock; racing builders keep the first
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      return it->second->second;
+    }
+    lru_.emplace_front(key, e);
+    index_.emplace(key, lru_.begin());
+    bytes_ += e->bytes;
+    while (bytes_ > budget_ && lru_.size() > 1) {
+      bytes_ -= lru_.back().second->bytes;
+      index_.erase(lru_.back().first);
+      lru_.pop_back();
+      ++stats_.evictions;
+    }
+    return e;
+  }
+
+  size_t budget_;
+  size_t bytes_ = 0;
+  Stats stats_;
+  std::list<std::pair<std::string, EntryPtr>> lru_;
+  std::unordered_map<std::string, std::list<std::pair<std::string, EntryPtr>>::iterator> index_;
+  mutable std::mutex mu_;
+};
+
+} // namespace csketch
@@ -1,44 +1,268 @@
 #pragma once
 #include <cstdint>
+#include <cstring>
+#include <limits>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <stdexcept>
 #include <type_traits>
 
+#include "csketch/memory.hpp"
+
 
 namespace csketch {
 
 
-enum class DType { U32, U64 };
+// STR columns are sketched over the u32 ids of an order-preserving
+// dictionary (see dictionary.hpp); their base file holds those ids.
+enum class DType { U32, U64, I32, I64, F32, F64, STR };
+
+
+inline DType parse_dtype(const std::string& s) {
+if (s == "u32") return DType::U32;
+if (s == "u64") return DType::U64;
+if (s == "i32") return DType::I32;
+if (s == "i64") return DType::I64;
+if (s == "f32") return DType::F32;
+if (s == "f64") return DType::F64;
+if (s == "str") return DType::STR;
+throw std::runtime_error("unknown dtype: " + s);
+}
+
+
+inline const char* dtype_name(DType t) {
+switch (t) {
+case DType::U32: return "u32";
+case DType::U64: return "u64";
+case DType::I32: return "i32";
+case DType::I64: return "i64";
+case DType::F32: return "f32";
+case DType::F64: return "f64";
+case DType::STR: return "str";
+}
+return "u64";
+}
+
+
+// Order-preserving keys: every column is sketched and scanned as uint64_t keys
+// with key(a) < key(b) iff a < b. Unsigned values are their own key, signed
+// values flip the sign bit, and floats use the IEEE total order (negative
+// values have all bits inverted, positive ones the sign bit set). -0.0 is
+// folded onto +0.0 so equality matches both; NaNs sort past +/-inf.
 
 
-// Generic binary reader/writer for POD integers
+template <class T>
+uint64_t to_key(T v) {
+static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value, "Arithmetic T only");
+if constexpr (std::is_floating_point<T>::value) {
+using Bits = typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type;
+constexpr Bits sign = Bits(1) << (sizeof(T) * 8 - 1);
+if (v == T(0)) v = T(0);
+Bits b;
+std::memcpy(&b, &v, sizeof(T));
+return (b & sign) ? static_cast<Bits>(~b) : static_cast<Bits>(b | sign);
+} else if constexpr (std::is_signed<T>::value) {
+using U = typename std::make_unsigned<T>::type;
+constexpr U sign = U(1) << (sizeof(T) * 8 - 1);
+return static_cast<U>(static_cast<U>(v) ^ sign);
+} else {
+return static_cast<uint64_t>(v);
+}
+}
 
 
 template <class T>
-std::vector<T> read_binary(const std::string& path) {
-static_assert(std::is_integral<T>::value && !std::is_same<T, bool>::value, "Integral T only");
+T from_key(uint64_t k) {
+static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value, "Arithmetic T only");
+if constexpr (std::is_floating_point<T>::value) {
+using Bits = typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type;
+constexpr Bits sign = Bits(1) << (sizeof(T) * 8 - 1);
+Bits b = static_cast<Bits>(k);
+b = (b & sign) ? static_cast<Bits>(b & ~sign) : static_cast<Bits>(~b);
+T v;
+std::memcpy(&v, &b, sizeof(T));
+return v;
+} else if constexpr (std::is_signed<T>::value) {
+using U = typename std::make_unsigned<T>::type;
+constexpr U sign = U(1) << (sizeof(T) * 8 - 1);
+return static_cast<T>(static_cast<U>(static_cast<U>(k) ^ sign));
+} else {
+return static_cast<T>(k);
+}
+}
+
+
+// Generic binary reader/writer for POD numbers
+
+
+template <class T>
+ColumnVector<T> read_binary(const std::string& path) {
+static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value, "Arithmetic T only");
 std::ifstream in(path, std::ios::binary | std::ios::ate);
 if (!in) throw std::runtime_error("read_binary: cannot open file");
 const std::streamsize bytes = in.tellg();
 if (bytes % static_cast<std::streamsize>(sizeof(T)) != 0) {
 throw std::runtime_error("read_binary: size not multiple of T");
 }
-std::vector<T> out(bytes / sizeof(T));
+ColumnVector<T> out;
+resize_uninitialized(out, static_cast<size_t>(bytes) / sizeof(T));
 in.seekg(0);
 if (!out.empty()) in.read(reinterpret_cast<char*>(out.data()), bytes);
 return out;
 }
 
 
-template <class T>
-void write_binary(const std::string& path, const std::vector<T>& data) {
-static_assert(std::is_integral<T>::value && !std::is_same<T, bool>::value, "Integral T only");
+template <class T, class Alloc>
+void write_binary(const std::string& path, const std::vector<T, Alloc>& data) {
+static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value, "Arithmetic T only");
 std::ofstream out(path, std::ios::binary);
 if (!out) throw std::runtime_error("write_binary: cannot open file");
 if (!data.empty()) out.write(reinterpret_cast<const char*>(data.data()), data.size()*sizeof(T));
 }
 
 
-} // namespace csketch
\ No newline at end of file
+template <class T>
+ColumnVector<uint64_t> read_keys_as(const std::string& path) {
+auto v = read_binary<T>(path);
+ColumnVector<uint64_t> keys;
+resize_uninitialized(keys, v.size());
+for (size_t i = 0; i < v.size(); ++i) keys[i] = to_key<T>(v[i]);
+return keys;
+}
+
+
+// Read a column of any DType as order-preserving keys.
+inline ColumnVector<uint64_t> read_column_keys(const std::string& path, DType t) {
+switch (t) {
+case DType::U32: return read_keys_as<uint32_t>(path);
+case DType::U64: return read_binary<uint64_t>(path);
+case DType::I32: return read_keys_as<int32_t>(path);
+case DType::I64: return read_keys_as<int64_t>(path);
+case DType::F32: return read_keys_as<float>(path);
+case DType::F64: return read_keys_as<double>(path);
+case DType::STR: return read_keys_as<uint32_t>(path);
+}
+throw std::runtime_error("read_column_keys: bad dtype");
+}
+
+
+template <class T, class Alloc>
+void write_keys_as(const std::string& path, const std::vector<uint64_t, Alloc>& keys) {
+ColumnVector<T> v;
+resize_uninitialized(v, keys.size());
+for (size_t i = 0; i < keys.size(); ++i) v[i] = from_key<T>(keys[i]);
+write_binary(path, v);
+}
+
+
+// Write keys back out as a raw column of the given DType (STR: u32 ids).
+template <class Alloc>
+void write_column_keys(const std::string& path, const std::vector<uint64_t, Alloc>& keys, DType t) {
+switch (t) {
+case DType::U32: write_keys_as<uint32_t>(path, keys); return;
+case DType::U64: write_binary(path, keys); return;
+case DType::I32: write_keys_as<int32_t>(path, keys); return;
+case DType::I64: write_keys_as<int64_t>(path, keys); return;
+case DType::F32: write_keys_as<float>(path, keys); return;
+case DType::F64: write_keys_as<double>(path, keys); return;
+case DType::STR: write_keys_as<uint32_t>(path, keys); return;
+}
+}
+
+
+// Parse a literal (e.g. a query constant) of the given DType into its key.
+inline uint64_t parse_key(const std::string& s, DType t) {
+size_t idx = 0;
+uint64_t key = 0;
+switch (t) {
+case DType::U32: {
+unsigned long long v = std::stoull(s, &idx);
+if (v > std::numeric_limits<uint32_t>::max()) throw std::out_of_range("parse_key: u32 out of range");
+key = to_key<uint32_t>(static_cast<uint32_t>(v));
+break;
+}
+case DType::U64: key = to_key<uint64_t>(std::stoull(s, &idx)); break;
+case DType::I32: {
+long long v = std::stoll(s, &idx);
+if (v < std::numeric_limits<int32_t>::min() || v > std::numeric_limits<int32_t>::max())
+throw std::out_of_range("parse_key: i32 out of range");
+key = to_key<int32_t>(static_cast<int32_t>(v));
+break;
+}
+case DType::I64: key = to_key<int64_t>(std::stoll(s, &idx)); break;
+case DType::F32: key = to_key<float>(std::stof(s, &idx)); break;
+case DType::F64: key = to_key<double>(std::stod(s, &idx)); break;
+case DType::STR: throw std::runtime_error("parse_key: str constants go through a StringDictionary");
+}
+if (idx != s.size()) throw std::runtime_error("parse_key: invalid value '" + s + "'");
+return key;
+}
+
+
+// Numeric value of a key, for aggregates (STR: the dictionary id).
+inline double key_value(uint64_t k, DType t) {
+switch (t) {
+case DType::U32: return static_cast<double>(from_key<uint32_t>(k));
+case DType::U64: return static_cast<double>(k);
+case DType::I32: return static_cast<double>(from_key<int32_t>(k));
+case DType::I64: return static_cast<double>(from_key<int64_t>(k));
+case DType::F32: return static_cast<double>(from_key<float>(k));
+case DType::F64: return from_key<double>(k);
+case DType::STR: return static_cast<double>(k);
+}
+return static_cast<double>(k);
+}
+
+
+// Variable-length string column. On disk (.strs): u64 count, u64 offsets[count+1],
+// then the concatenated bytes; string i is bytes[offsets[i], offsets[i+1]).
+
+
+struct StringColumn {
+std::vector<uint64_t> offsets{0};
+std::string bytes;
+
+size_t size() const { return offsets.size() - 1; }
+std::string_view operator[](size_t i) const {
+return std::string_view(bytes.data() + offsets[i], offsets[i+1] - offsets[i]);
+}
+void push_back(std::string_view v) {
+bytes.append(v.data(), v.size());
+offsets.push_back(bytes.size());
+}
+};
+
+
+inline StringColumn read_strings(const std::string& path) {
+std::ifstream in(path, std::ios::binary);
+if (!in) throw std::runtime_error("read_strings: cannot open file");
+uint64_t n = 0;
+in.read(reinterpret_cast<char*>(&n), sizeof(n));
+if (!in) throw std::runtime_error("read_strings: truncated header");
+StringColumn col;
+col.offsets.resize(n + 1);
+in.read(reinterpret_cast<char*>(col.offsets.data()), (n + 1) * sizeof(uint64_t));
+if (!in || col.offsets[0] != 0) throw std::runtime_error("read_strings: bad offsets");
+for (uint64_t i = 0; i < n; ++i) {
+if (col.offsets[i+1] < col.offsets[i]) throw std::runtime_error("read_strings: bad offsets");
+}
+col.bytes.resize(col.offsets[n]);
+if (!col.bytes.empty()) in.read(&col.bytes[0], col.bytes.size());
+if (!in) throw std::runtime_error("read_strings: truncated payload");
+return col;
+}
+
+
+inline void write_strings(const std::string& path, const StringColumn& col) {
+std::ofstream out(path, std::ios::binary);
+if (!out) throw std::runtime_error("write_strings: cannot open file");
+const uint64_t n = col.size();
+out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+out.write(reinterpret_cast<const char*>(col.offsets.data()), col.offsets.size() * sizeof(uint64_t));
+if (!col.bytes.empty()) out.write(col.bytes.data(), col.bytes.size());
+}
+
+
+} // namespace csketch
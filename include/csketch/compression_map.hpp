@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cstdint>
 #include <fstream>
+#include <limits>
 #include <stdexcept>
 #include <string>
 #include <utility>
@@ -10,15 +11,34 @@
 
 namespace csketch {
 
+// Code numbering written with every map (map JSON, container MAP section,
+// partition manifest). 2 is the order-preserving code_of(); maps without a
+// format were numbered differently and must be rebuilt.
+constexpr uint32_t kMapFormat = 2;
+
 struct MapArtifacts {
   std::vector<uint64_t> uniques;   // explicit singleton codes (sorted)
   std::vector<uint64_t> endpoints; // inclusive range boundaries (sorted, deduped)
   uint32_t total_codes = 0;
 };
 
+// Per-code statistics of the encoded column: rows, min/max key and the sum of
+// values (in the column's value domain, see key_value()). Maps saved before
+// stats existed load with all vectors empty.
+struct CodeStats {
+  std::vector<uint64_t> rows;
+  std::vector<uint64_t> min_key; // undefined where rows == 0
+  std::vector<uint64_t> max_key;
+  std::vector<double> sum;
+
+  bool empty() const { return rows.empty(); }
+  size_t size() const { return rows.size(); }
+};
+
 class NumericCompressionMap {
 public:
-  static MapArtifacts build(const std::vector<uint64_t> &values, uint32_t max_codes,
+  template <class Alloc>
+  static MapArtifacts build(const std::vector<uint64_t, Alloc> &values, uint32_t max_codes,
                             size_t sample_size, size_t unique_cutoff) {
     if (values.empty()) {
       throw std::invalid_argument("NumericCompressionMap::build requires non-empty input");
@@ -33,7 +53,7 @@ public:
       unique_cutoff = 1;
     }
 
-    std::vector<uint64_t> sorted(values);
+    std::vector<uint64_t> sorted(values.begin(), values.end());
     std::sort(sorted.begin(), sorted.end());
 
     struct Run {
@@ -64,9 +84,30 @@ public:
     MapArtifacts art;
     art.uniques = std::move(uniques);
 
-    if (art.uniques.size() >= max_codes) {
+    if (nonuniq_runs.empty() && art.uniques.size() < max_codes) {
+      art.total_codes = static_cast<uint32_t>(art.uniques.size());
+      return art;
+    }
+
+    // A unique owns its code (is_exact()) only when the range below it ends
+    // at u - 1 and a code follows it, so each unique not directly after
+    // another one takes a separator endpoint, and the top unique a trailing
+    // range. Both come out of the range-code budget.
+    std::vector<uint64_t> separators;
+    for (size_t i = 0; i < art.uniques.size(); ++i) {
+      const uint64_t u = art.uniques[i];
+      if (u > 0 && (i == 0 || art.uniques[i - 1] != u - 1)) {
+        separators.push_back(u - 1);
+      }
+    }
+    bool trailing =
+        !art.uniques.empty() && art.uniques.back() != std::numeric_limits<uint64_t>::max();
+
+    if (art.uniques.size() + separators.size() + (trailing ? 1 : 0) >= max_codes) {
       // Demote uniques to ranges to stay within code budget.
       art.uniques.clear();
+      separators.clear();
+      trailing = false;
       nonuniq_runs.clear();
       for (size_t i = 0; i < sorted.size();) {
         size_t j = i + 1;
@@ -76,13 +117,6 @@ public:
         nonuniq_runs.push_back({sorted[i], j - i});
         i = j;
       }
-    } else if (nonuniq_runs.empty()) {
-      art.total_codes = static_cast<uint32_t>(art.uniques.size());
-      return art;
-    }
-
-    if (max_codes <= art.uniques.size()) {
-      throw std::runtime_error("max_codes must exceed number of unique codes");
     }
 
     size_t total_nonuniq = 0;
@@ -119,8 +153,8 @@ public:
       }
     }
 
-    const uint32_t range_codes =
-        static_cast<uint32_t>(max_codes - static_cast<uint32_t>(art.uniques.size()));
+    const uint32_t range_codes = static_cast<uint32_t>(
+        max_codes - art.uniques.size() - separators.size() - (trailing ? 1 : 0));
 
     if (range_codes == 0) {
       throw std::runtime_error("range_codes resolved to zero");
@@ -143,50 +177,380 @@ public:
       endpoints.push_back(bound);
     }
 
-    std::sort(endpoints.begin(), endpoints.end());
-    endpoints.erase(std::unique(endpoints.begin(), endpoints.end()), endpoints.end());
     if (endpoints.empty() || endpoints.back() < sample_nonuniq.back()) {
       endpoints.push_back(sample_nonuniq.back());
     }
+    endpoints.insert(endpoints.end(), separators.begin(), separators.end());
+    std::sort(endpoints.begin(), endpoints.end());
+    endpoints.erase(std::unique(endpoints.begin(), endpoints.end()), endpoints.end());
+    if (trailing && art.uniques.back() > endpoints.back()) {
+      endpoints.push_back(std::numeric_limits<uint64_t>::max());
+    }
 
     art.endpoints = std::move(endpoints);
     art.total_codes = static_cast<uint32_t>(art.uniques.size() + art.endpoints.size());
     return art;
   }
 
+  // Cost-optimal variant of build(). A query constant that lands in range
+  // bucket b makes the scan probe base for every row coded b, so the expected
+  // probe count is sum_b W(b) * F(b), with F the bucket's row mass and W the
+  // chance a constant falls into it. W follows the data distribution unless
+  // `workload` (query constants, e.g. v1/v2 from a query log) is given.
+  //
+  // Values heavier than an average bucket (and >= unique_cutoff) become exact
+  // uniques; the remaining values are grouped into at most sample_size atoms
+  // and split into ranges by a dynamic program minimising the cost above.
+  template <class Alloc>
+  static MapArtifacts build_optimal(const std::vector<uint64_t, Alloc> &values,
+                                    uint32_t max_codes, size_t sample_size,
+                                    size_t unique_cutoff,
+                                    const std::vector<uint64_t> &workload = {}) {
+    if (values.empty()) {
+      throw std::invalid_argument("NumericCompressionMap::build_optimal requires non-empty input");
+    }
+    if (max_codes < 2) {
+      throw std::invalid_argument("NumericCompressionMap::build_optimal max_codes must be >= 2");
+    }
+    if (sample_size == 0) {
+      sample_size = 1;
+    }
+    if (unique_cutoff == 0) {
+      unique_cutoff = 1;
+    }
+
+    std::vector<uint64_t> sorted(values.begin(), values.end());
+    std::sort(sorted.begin(), sorted.end());
+
+    struct Run {
+      uint64_t value;
+      double freq;
+      double weight;
+    };
+    std::vector<Run> runs;
+    for (size_t i = 0; i < sorted.size();) {
+      size_t j = i + 1;
+      while (j < sorted.size() && sorted[j] == sorted[i]) {
+        ++j;
+      }
+      runs.push_back({sorted[i], static_cast<double>(j - i), 0.0});
+      i = j;
+    }
+    sorted.clear();
+    sorted.shrink_to_fit();
+
+    // Query weight per run. Constants between two runs fall into the bucket
+    // of the next run; a small share of data-proportional weight keeps
+    // resolution in regions the log never touched.
+    const double n_rows = static_cast<double>(values.size());
+    if (workload.empty()) {
+      for (auto &r : runs) {
+        r.weight = r.freq / n_rows;
+      }
+    } else {
+      constexpr double kDataShare = 0.05;
+      std::vector<double> hits(runs.size(), 0.0);
+      for (uint64_t q : workload) {
+        auto it = std::lower_bound(runs.begin(), runs.end(), q,
+                                   [](const Run &r, uint64_t v) { return r.value < v; });
+        size_t idx = (it == runs.end()) ? runs.size() - 1 : static_cast<size_t>(it - runs.begin());
+        hits[idx] += 1.0;
+      }
+      const double nq = static_cast<double>(workload.size());
+      for (size_t i = 0; i < runs.size(); ++i) {
+        runs[i].weight = (1.0 - kDataShare) * hits[i] / nq + kDataShare * runs[i].freq / n_rows;
+      }
+    }
+
+    // Pick uniques by the cost they remove, then drop the weakest until the
+    // layout (one code per unique, separators, one range per gap) fits.
+    std::vector<size_t> cand;
+    const double heavy = n_rows / max_codes;
+    for (size_t i = 0; i < runs.size(); ++i) {
+      if (runs[i].freq >= static_cast<double>(unique_cutoff) && runs[i].freq >= heavy) {
+        cand.push_back(i);
+      }
+    }
+    std::sort(cand.begin(), cand.end(), [&](size_t a, size_t b) {
+      return runs[a].weight * runs[a].freq > runs[b].weight * runs[b].freq;
+    });
+    if (cand.size() > max_codes / 2) {
+      cand.resize(max_codes / 2);
+    }
+
+    std::vector<char> is_unique(runs.size(), 0);
+    size_t separators = 0;
+    auto layout_codes = [&](size_t &min_segments) {
+      separators = 0;
+      min_segments = 0;
+      bool prev_unique = false;
+      bool have_prev = false;
+      for (size_t i = 0; i < runs.size(); ++i) {
+        if (is_unique[i]) {
+          const uint64_t u = runs[i].value;
+          if (!have_prev) {
+            separators += (u > 0);
+          } else if (prev_unique && u - 1 > runs[i - 1].value) {
+            ++separators;
+          }
+          ++min_segments;
+          prev_unique = true;
+        } else {
+          if (!have_prev || prev_unique) {
+            ++min_segments;
+          }
+          prev_unique = false;
+        }
+        have_prev = true;
+      }
+      if (prev_unique && runs.back().value != std::numeric_limits<uint64_t>::max()) {
+        ++separators; // trailing range so the last unique is not clamped
+      }
+      return min_segments + separators;
+    };
+
+    for (size_t i : cand) {
+      is_unique[i] = 1;
+    }
+    size_t min_segments = 0;
+    while (layout_codes(min_segments) > max_codes && !cand.empty()) {
+      is_unique[cand.back()] = 0;
+      cand.pop_back();
+    }
+    if (layout_codes(min_segments) > max_codes) {
+      throw std::runtime_error("max_codes too small for optimal layout");
+    }
+
+    // Group runs into atoms: uniques stand alone, other runs are merged up to
+    // an equal share of the non-unique mass. The DP keeps one parent index per
+    // (codes, atom) so the atom count is bounded by kTableCells / codes.
+    struct Atom {
+      uint64_t value; // largest value in the atom
+      double freq;
+      double weight;
+      bool unique;
+    };
+    constexpr size_t kTableCells = size_t(1) << 22;
+    const size_t dp_codes = max_codes - separators;
+    const size_t atom_cap =
+        std::max<size_t>(std::min(sample_size, std::max<size_t>(dp_codes, kTableCells / dp_codes)), 1);
+    double nonuniq_mass = 0.0;
+    for (size_t i = 0; i < runs.size(); ++i) {
+      if (!is_unique[i]) {
+        nonuniq_mass += runs[i].freq;
+      }
+    }
+    const double target = nonuniq_mass / static_cast<double>(atom_cap);
+
+    std::vector<Atom> atoms;
+    bool open = false;
+    for (size_t i = 0; i < runs.size(); ++i) {
+      if (is_unique[i]) {
+        atoms.push_back({runs[i].value, runs[i].freq, runs[i].weight, true});
+        open = false;
+        continue;
+      }
+      if (!open) {
+        atoms.push_back({runs[i].value, 0.0, 0.0, false});
+        open = true;
+      }
+      Atom &a = atoms.back();
+      a.value = runs[i].value;
+      a.freq += runs[i].freq;
+      a.weight += runs[i].weight;
+      if (a.freq >= target) {
+        open = false;
+      }
+    }
+    runs.clear();
+
+    // dp over atoms: cost[j, i) = W * F for a range of non-unique atoms, 0 for
+    // a lone unique, infinite otherwise. The cost obeys the quadrangle
+    // inequality, so each layer is solved by divide and conquer.
+    const size_t S = atoms.size();
+    const size_t K = std::min(dp_codes, S);
+    std::vector<double> PW(S + 1, 0.0), PF(S + 1, 0.0);
+    std::vector<size_t> jmin(S + 1, 0);
+    for (size_t i = 0; i < S; ++i) {
+      PW[i + 1] = PW[i] + atoms[i].weight;
+      PF[i + 1] = PF[i] + atoms[i].freq;
+      if (atoms[i].unique) {
+        jmin[i + 1] = i;
+      } else if (i > 0 && !atoms[i - 1].unique) {
+        jmin[i + 1] = jmin[i];
+      } else {
+        jmin[i + 1] = i;
+      }
+    }
+    const double inf = std::numeric_limits<double>::infinity();
+    auto cost = [&](size_t j, size_t i) -> double {
+      if (j < jmin[i]) {
+        return inf;
+      }
+      if (atoms[i - 1].unique) {
+        return 0.0;
+      }
+      return (PW[i] - PW[j]) * (PF[i] - PF[j]);
+    };
+
+    std::vector<double> prev(S + 1, inf), cur(S + 1, inf);
+    std::vector<uint32_t> parent;
+    prev[0] = 0.0;
+    double best = inf;
+    size_t best_k = 0;
+    if (K < S) {
+      parent.resize(K * (S + 1), 0);
+    }
+
+    for (size_t k = 1; k <= K && K < S; ++k) {
+      std::fill(cur.begin(), cur.end(), inf);
+      uint32_t *par = parent.data() + (k - 1) * (S + 1);
+      struct Frame {
+        size_t lo, hi, optlo, opthi;
+      };
+      std::vector<Frame> stack{{1, S, 0, S - 1}};
+      while (!stack.empty()) {
+        Frame f = stack.back();
+        stack.pop_back();
+        if (f.lo > f.hi) {
+          continue;
+        }
+        const size_t mid = f.lo + (f.hi - f.lo) / 2;
+        const size_t from = std::max(f.optlo, jmin[mid]);
+        const size_t to = std::min(mid - 1, f.opthi);
+        size_t opt = std::min(from, to);
+        double v = inf;
+        for (size_t j = from; j <= to; ++j) {
+          const double c = prev[j] + cost(j, mid);
+          if (c < v) {
+            v = c;
+            opt = j;
+          }
+        }
+        cur[mid] = v;
+        par[mid] = static_cast<uint32_t>(opt);
+        if (mid > f.lo) {
+          stack.push_back({f.lo, mid - 1, f.optlo, opt});
+        }
+        stack.push_back({mid + 1, f.hi, opt, f.opthi});
+      }
+      if (cur[S] < best) {
+        best = cur[S];
+        best_k = k;
+      }
+      std::swap(prev, cur);
+    }
+    std::vector<size_t> cuts; // segment end positions
+    if (K == S) {
+      for (size_t i = 1; i <= S; ++i) {
+        cuts.push_back(i); // enough codes for one per atom
+      }
+    } else {
+      if (best_k == 0) {
+        throw std::runtime_error("build_optimal found no feasible layout");
+      }
+      for (size_t i = S, k = best_k; k > 0; --k) {
+        cuts.push_back(i);
+        i = parent[(k - 1) * (S + 1) + i];
+      }
+      std::reverse(cuts.begin(), cuts.end());
+    }
+
+    MapArtifacts art;
+    size_t start = 0;
+    bool last_unique = false;
+    for (size_t end : cuts) {
+      const Atom &a = atoms[end - 1];
+      if (a.unique) {
+        const uint64_t u = a.value;
+        if (start == 0 || last_unique) {
+          const bool gap = (start == 0) ? (u > 0) : (u - 1 > art.uniques.back());
+          if (gap) {
+            art.endpoints.push_back(u - 1);
+          }
+        } else {
+          art.endpoints.back() = u - 1; // stretch range up to the unique
+        }
+        art.uniques.push_back(u);
+      } else {
+        art.endpoints.push_back(a.value);
+      }
+      last_unique = a.unique;
+      start = end;
+    }
+    if (last_unique && art.uniques.back() != std::numeric_limits<uint64_t>::max()) {
+      art.endpoints.push_back(std::numeric_limits<uint64_t>::max());
+    }
+    art.total_codes = static_cast<uint32_t>(art.uniques.size() + art.endpoints.size());
+    return art;
+  }
+
+  // Codes are order-preserving: code(v) = #uniques < v + #endpoints < v, with
+  // values past the last endpoint clamped onto the last range. A unique only
+  // owns its code outright when is_exact() says so.
   static std::pair<uint32_t, bool> code_of(const MapArtifacts &art, uint64_t v) {
     const auto &U = art.uniques;
     const auto &E = art.endpoints;
     auto uit = std::lower_bound(U.begin(), U.end(), v);
-    if (uit != U.end() && *uit == v) {
-      uint32_t idx = static_cast<uint32_t>(uit - U.begin());
-      return {idx, false};
-    }
+    const bool unique = (uit != U.end() && *uit == v);
+    const uint32_t u_index = static_cast<uint32_t>(uit - U.begin());
 
     if (E.empty()) {
+      if (unique) {
+        return {u_index, false};
+      }
       throw std::runtime_error("value not encodable (no range endpoints)");
     }
 
     auto eit = std::lower_bound(E.begin(), E.end(), v);
     if (eit == E.end()) {
-      uint32_t code = static_cast<uint32_t>(U.size() + (E.size() - 1));
+      uint32_t code = static_cast<uint32_t>(u_index + (E.size() - 1));
       return {code, false};
     }
-    bool is_boundary = (*eit == v);
+    bool is_boundary = !unique && (*eit == v);
     uint32_t e_index = static_cast<uint32_t>(eit - E.begin());
-    uint32_t code =
-        static_cast<uint32_t>((uit - U.begin()) + e_index);
-    return {code, is_boundary};
+    return {u_index + e_index, is_boundary};
+  }
+
+  // True when v is a unique and no other value can map to its code, so rows
+  // carrying that code need no base probe.
+  static bool is_exact(const MapArtifacts &art, uint64_t v) {
+    const auto &U = art.uniques;
+    const auto &E = art.endpoints;
+    auto uit = std::lower_bound(U.begin(), U.end(), v);
+    if (uit == U.end() || *uit != v) {
+      return false;
+    }
+    if (E.empty()) {
+      return true;
+    }
+    auto eit = std::lower_bound(E.begin(), E.end(), v);
+    if (eit == E.end()) {
+      return false; // shares the clamped last-range code
+    }
+    bool has_prev = false;
+    uint64_t prev = 0;
+    if (uit != U.begin()) {
+      prev = *(uit - 1);
+      has_prev = true;
+    }
+    if (eit != E.begin() && (!has_prev || *(eit - 1) > prev)) {
+      prev = *(eit - 1);
+      has_prev = true;
+    }
+    return has_prev ? (prev == v - 1) : (v == 0);
   }
 };
 
 inline void save_map_json(const MapArtifacts &art, const std::string &path,
-                          const std::string &dtype, uint32_t code_bits) {
+                          const std::string &dtype, uint32_t code_bits,
+                          const CodeStats &stats = CodeStats{}) {
   std::ofstream out(path);
   if (!out) {
     throw std::runtime_error("save_map_json: cannot open file");
   }
   out << "{\n";
+  out << " \"format\": " << kMapFormat << ",\n";
   out << " \"dtype\": \"" << dtype << "\",\n";
   out << " \"code_bits\": " << code_bits << ",\n";
   out << " \"total_codes\": " << art.total_codes << ",\n";
@@ -204,7 +568,25 @@ inline void save_map_json(const MapArtifacts &art, const std::string &path,
     }
     out << art.endpoints[i];
   }
-  out << "]\n}";
+  out << "]";
+  if (!stats.empty()) {
+    auto array = [&](const char *key, const auto &v) {
+      out << ",\n \"" << key << "\": [";
+      for (size_t i = 0; i < v.size(); ++i) {
+        if (i) {
+          out << ",";
+        }
+        out << v[i];
+      }
+      out << "]";
+    };
+    out.precision(17);
+    array("code_rows", stats.rows);
+    array("code_min", stats.min_key);
+    array("code_max", stats.max_key);
+    array("code_sum", stats.sum);
+  }
+  out << "\n}";
 }
 
 } // namespace csketch
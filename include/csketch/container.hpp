@@ -0,0 +1,340 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "csketch/checksum.hpp"
+#include "csketch/column.hpp"
+#include "csketch/compression_map.hpp"
+#include "csketch/memory.hpp"
+#include "csketch/mmap_file.hpp"
+#include "csketch/scan.hpp"
+#include "csketch/sketch.hpp"
+
+namespace csketch {
+
+// ---------------------------------------------------------------------
+//  Single-file column container (.csk)
+//
+//  [ header | section directory | pad ] [ section ] [ pad ] [ section ] ...
+//
+//  Every section starts on a 4 KiB boundary, so one read-only mmap exposes
+//  the base keys and codes in place for the scan kernels. Each directory
+//  entry carries the section's CRC-32C. All integers are little-endian.
+//
+//  BASE     rows x u64 order-preserving keys (see column.hpp)
+//  CODES    rows x u8 or u16 codes
+//  MAP      u32 total_codes, u32 map format (kMapFormat), u64 n_uniques, u64 n_endpoints,
+//           uniques[], endpoints[]
+//  ZONEMAP  u64 zone_rows, u64 n_zones, then {min, max} key per zone
+//  STATS    u64 min key, u64 max key, u64 total_codes, rows per code[],
+//           then optionally min key[], max key[] and f64 value sum[] per code
+// ---------------------------------------------------------------------
+
+enum class SectionKind : uint32_t { Base = 1, Codes = 2, Map = 3, ZoneMap = 4, Stats = 5 };
+
+constexpr uint64_t kContainerAlign = 4096;
+constexpr uint32_t kContainerVersion = 1;
+constexpr char kContainerMagic[8] = {'C', 'S', 'K', 'E', 'T', 'C', 'H', '1'};
+
+struct ContainerHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t section_count;
+  uint64_t rows;
+  uint32_t dtype;     // DType
+  uint32_t code_bits; // 8 or 16
+  uint64_t reserved[4];
+};
+static_assert(sizeof(ContainerHeader) == 64, "container header is 64 bytes");
+
+struct SectionEntry {
+  uint32_t kind;     // SectionKind
+  uint32_t checksum; // CRC-32C of the section bytes
+  uint64_t offset;
+  uint64_t bytes;
+};
+static_assert(sizeof(SectionEntry) == 24, "section entry is 24 bytes");
+
+struct Zone {
+  uint64_t min_key;
+  uint64_t max_key;
+};
+
+inline void write_container(const std::string &path, DType dtype, const ColumnVector<uint64_t> &keys,
+                            const MapArtifacts &art, const EncodedSketch &sk,
+                            uint64_t zone_rows = 65536, const CodeStats &code_stats = CodeStats{}) {
+  if (keys.size() != sk.size()) {
+    throw std::invalid_argument("write_container: codes and base lengths differ");
+  }
+  if (keys.empty()) {
+    throw std::invalid_argument("write_container: empty column");
+  }
+  if (zone_rows == 0) {
+    throw std::invalid_argument("write_container: zone_rows must be > 0");
+  }
+
+  auto put = [](std::vector<uint8_t> &buf, const void *p, size_t n) {
+    const uint8_t *b = static_cast<const uint8_t *>(p);
+    buf.insert(buf.end(), b, b + n);
+  };
+  auto put64 = [&](std::vector<uint8_t> &buf, uint64_t v) { put(buf, &v, sizeof(v)); };
+
+  std::vector<uint8_t> map_buf;
+  const uint32_t total_codes = art.total_codes;
+  const uint32_t map_format = kMapFormat;
+  put(map_buf, &total_codes, sizeof(total_codes));
+  put(map_buf, &map_format, sizeof(map_format));
+  put64(map_buf, art.uniques.size());
+  put64(map_buf, art.endpoints.size());
+  put(map_buf, art.uniques.data(), art.uniques.size() * sizeof(uint64_t));
+  put(map_buf, art.endpoints.data(), art.endpoints.size() * sizeof(uint64_t));
+
+  std::vector<uint8_t> zone_buf;
+  const uint64_t n_zones = (keys.size() + zone_rows - 1) / zone_rows;
+  put64(zone_buf, zone_rows);
+  put64(zone_buf, n_zones);
+  uint64_t gmin = keys[0], gmax = keys[0];
+  for (uint64_t z = 0; z < n_zones; ++z) {
+    const auto b = keys.begin() + static_cast<std::ptrdiff_t>(z * zone_rows);
+    const auto e = keys.begin() + static_cast<std::ptrdiff_t>(std::min<uint64_t>(keys.size(), (z + 1) * zone_rows));
+    auto mm = std::minmax_element(b, e);
+    put64(zone_buf, *mm.first);
+    put64(zone_buf, *mm.second);
+    gmin = std::min(gmin, *mm.first);
+    gmax = std::max(gmax, *mm.second);
+  }
+
+  std::vector<uint8_t> stats_buf;
+  put64(stats_buf, gmin);
+  put64(stats_buf, gmax);
+  put64(stats_buf, sk.code_rows.size());
+  put(stats_buf, sk.code_rows.data(), sk.code_rows.size() * sizeof(uint64_t));
+  if (!code_stats.empty()) {
+    if (code_stats.size() != sk.code_rows.size()) {
+      throw std::invalid_argument("write_container: code stats do not match the sketch");
+    }
+    put(stats_buf, code_stats.min_key.data(), code_stats.size() * sizeof(uint64_t));
+    put(stats_buf, code_stats.max_key.data(), code_stats.size() * sizeof(uint64_t));
+    put(stats_buf, code_stats.sum.data(), code_stats.size() * sizeof(double));
+  }
+
+  struct Pending {
+    SectionKind kind;
+    const void *data;
+    uint64_t bytes;
+  };
+  const std::vector<Pending> sections = {
+      {SectionKind::Base, keys.data(), keys.size() * sizeof(uint64_t)},
+      {SectionKind::Codes, sk.data(), sk.bytes()},
+      {SectionKind::Map, map_buf.data(), map_buf.size()},
+      {SectionKind::ZoneMap, zone_buf.data(), zone_buf.size()},
+      {SectionKind::Stats, stats_buf.data(), stats_buf.size()},
+  };
+
+  auto align_up = [](uint64_t v) { return (v + kContainerAlign - 1) & ~(kContainerAlign - 1); };
+
+  ContainerHeader hdr{};
+  std::memcpy(hdr.magic, kContainerMagic, sizeof(hdr.magic));
+  hdr.version = kContainerVersion;
+  hdr.section_count = static_cast<uint32_t>(sections.size());
+  hdr.rows = keys.size();
+  hdr.dtype = static_cast<uint32_t>(dtype);
+  hdr.code_bits = sk.code_bits;
+
+  std::vector<SectionEntry> dir;
+  uint64_t offset = align_up(sizeof(ContainerHeader) + sections.size() * sizeof(SectionEntry));
+  for (const auto &s : sections) {
+    dir.push_back({static_cast<uint32_t>(s.kind), crc32c(s.data, s.bytes), offset, s.bytes});
+    offset = align_up(offset + s.bytes);
+  }
+
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    throw std::runtime_error("write_container: cannot open file");
+  }
+  out.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+  out.write(reinterpret_cast<const char *>(dir.data()), dir.size() * sizeof(SectionEntry));
+  uint64_t at = sizeof(hdr) + dir.size() * sizeof(SectionEntry);
+  const std::vector<char> zeros(kContainerAlign, 0);
+  for (size_t i = 0; i < sections.size(); ++i) {
+    out.write(zeros.data(), static_cast<std::streamsize>(dir[i].offset - at));
+    out.write(static_cast<const char *>(sections[i].data), static_cast<std::streamsize>(sections[i].bytes));
+    at = dir[i].offset + sections[i].bytes;
+  }
+  out.write(zeros.data(), static_cast<std::streamsize>(align_up(at) - at));
+  if (!out) {
+    throw std::runtime_error("write_container: write failed");
+  }
+}
+
+// Zero-copy view of a .csk file. Base keys and codes point into the
+// mapping; the (small) map is decoded once on open.
+class ContainerView {
+public:
+  explicit ContainerView(const std::string &path, bool verify_checksums = false)
+      : file_(path) {
+    if (file_.size() < sizeof(ContainerHeader)) {
+      throw std::runtime_error("ContainerView: file too small");
+    }
+    std::memcpy(&hdr_, file_.data(), sizeof(hdr_));
+    if (std::memcmp(hdr_.magic, kContainerMagic, sizeof(hdr_.magic)) != 0) {
+      throw std::runtime_error("ContainerView: bad magic");
+    }
+    if (hdr_.version != kContainerVersion) {
+      throw std::runtime_error("ContainerView: unsupported version");
+    }
+    if (hdr_.code_bits != 8 && hdr_.code_bits != 16) {
+      throw std::runtime_error("ContainerView: bad code width");
+    }
+    if (hdr_.dtype > static_cast<uint32_t>(DType::STR)) {
+      throw std::runtime_error("ContainerView: bad dtype");
+    }
+    const uint64_t dir_end = sizeof(ContainerHeader) + uint64_t(hdr_.section_count) * sizeof(SectionEntry);
+    if (dir_end > file_.size()) {
+      throw std::runtime_error("ContainerView: truncated directory");
+    }
+    dir_.resize(hdr_.section_count);
+    std::memcpy(dir_.data(), file_.data() + sizeof(ContainerHeader), dir_.size() * sizeof(SectionEntry));
+    for (const auto &e : dir_) {
+      if (e.offset % kContainerAlign != 0 || e.offset > file_.size() ||
+          e.bytes > file_.size() - e.offset) {
+        throw std::runtime_error("ContainerView: section out of bounds");
+      }
+    }
+    if (verify_checksums) {
+      verify();
+    }
+
+    if (section_bytes(SectionKind::Base) != rows() * sizeof(uint64_t) ||
+        section_bytes(SectionKind::Codes) != rows() * (hdr_.code_bits / 8)) {
+      throw std::runtime_error("ContainerView: base/codes size does not match rows");
+    }
+    check_zones();
+    decode_map();
+  }
+
+  uint64_t rows() const { return hdr_.rows; }
+  DType dtype() const { return static_cast<DType>(hdr_.dtype); }
+  uint32_t code_bits() const { return hdr_.code_bits; }
+
+  const uint64_t *base() const { return reinterpret_cast<const uint64_t *>(section(SectionKind::Base)); }
+  const void *codes() const { return section(SectionKind::Codes); }
+  const LoadedMap &map() const { return map_; }
+
+  uint64_t zone_rows() const { return zone_header()[0]; }
+  uint64_t zone_count() const { return zone_header()[1]; }
+  const Zone *zones() const { return reinterpret_cast<const Zone *>(zone_header() + 2); }
+
+  uint64_t min_key() const { return stats()[0]; }
+  uint64_t max_key() const { return stats()[1]; }
+  const uint64_t *code_rows() const { return stats() + 3; }
+
+  bool has(SectionKind kind) const { return find(kind) != nullptr; }
+
+  // File offset of a section, for readers that bypass the mapping.
+  uint64_t section_offset(SectionKind kind) const {
+    return static_cast<uint64_t>(section(kind) - file_.data());
+  }
+
+  // Recompute every section's CRC-32C; throws on the first mismatch.
+  void verify() const {
+    for (const auto &e : dir_) {
+      if (crc32c(file_.data() + e.offset, e.bytes) != e.checksum) {
+        throw std::runtime_error("ContainerView: checksum mismatch in section " + std::to_string(e.kind));
+      }
+    }
+  }
+
+private:
+  const SectionEntry *find(SectionKind kind) const {
+    for (const auto &e : dir_) {
+      if (e.kind == static_cast<uint32_t>(kind)) {
+        return &e;
+      }
+    }
+    return nullptr;
+  }
+  const uint8_t *section(SectionKind kind) const {
+    const SectionEntry *e = find(kind);
+    if (!e) {
+      throw std::runtime_error("ContainerView: missing section " + std::to_string(static_cast<uint32_t>(kind)));
+    }
+    return file_.data() + e->offset;
+  }
+  uint64_t section_bytes(SectionKind kind) const {
+    const SectionEntry *e = find(kind);
+    return e ? e->bytes : 0;
+  }
+  const uint64_t *zone_header() const {
+    return reinterpret_cast<const uint64_t *>(section(SectionKind::ZoneMap));
+  }
+  const uint64_t *stats() const { return reinterpret_cast<const uint64_t *>(section(SectionKind::Stats)); }
+
+  // The zone accessors read straight from the mapping, so the header and
+  // section size must agree with the row count before anyone calls them.
+  void check_zones() const {
+    const uint64_t bytes = section_bytes(SectionKind::ZoneMap);
+    if (bytes < 16) {
+      throw std::runtime_error("ContainerView: bad zone map section");
+    }
+    const uint64_t zrows = zone_header()[0], n = zone_header()[1];
+    if (zrows == 0 || n != rows() / zrows + (rows() % zrows != 0) || n > (bytes - 16) / sizeof(Zone) ||
+        bytes != 16 + n * sizeof(Zone)) {
+      throw std::runtime_error("ContainerView: bad zone map section");
+    }
+  }
+
+  void decode_map() {
+    const uint8_t *p = section(SectionKind::Map);
+    const uint64_t bytes = section_bytes(SectionKind::Map);
+    if (bytes < 24) {
+      throw std::runtime_error("ContainerView: truncated map");
+    }
+    uint32_t total = 0, format = 0;
+    uint64_t nu = 0, ne = 0;
+    std::memcpy(&total, p, 4);
+    std::memcpy(&format, p + 4, 4);
+    if (format != kMapFormat) {
+      throw std::runtime_error(format == 0 ? "ContainerView: map has no format version (built before "
+                                             "order-preserving codes); rebuild the container"
+                                           : "ContainerView: unsupported map format");
+    }
+    std::memcpy(&nu, p + 8, 8);
+    std::memcpy(&ne, p + 16, 8);
+    if (nu > bytes / 8 || ne > bytes / 8 || 24 + (nu + ne) * 8 != bytes) {
+      throw std::runtime_error("ContainerView: bad map section");
+    }
+    const uint64_t *u = reinterpret_cast<const uint64_t *>(p + 24);
+    map_.art.total_codes = total;
+    map_.art.uniques.assign(u, u + nu);
+    map_.art.endpoints.assign(u + nu, u + nu + ne);
+    map_.dtype = dtype_name(dtype());
+    map_.code_bits = hdr_.code_bits;
+
+    const uint64_t sbytes = section_bytes(SectionKind::Stats);
+    if (sbytes < 24 || stats()[2] != total || sbytes < (3 + stats()[2]) * 8) {
+      throw std::runtime_error("ContainerView: bad stats section");
+    }
+    if (sbytes == (3 + 4 * uint64_t(total)) * 8) {
+      const uint64_t *s = stats() + 3;
+      map_.stats.rows.assign(s, s + total);
+      map_.stats.min_key.assign(s + total, s + 2 * total);
+      map_.stats.max_key.assign(s + 2 * total, s + 3 * total);
+      map_.stats.sum.resize(total);
+      std::memcpy(map_.stats.sum.data(), s + 3 * total, total * sizeof(double));
+    }
+  }
+
+  MappedFile file_;
+  ContainerHeader hdr_{};
+  std::vector<SectionEntry> dir_;
+  LoadedMap map_;
+};
+
+} // namespace csketch
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "csketch/column.hpp"
+#include "csketch/scan.hpp"
+
+namespace csketch {
+
+// Order-preserving dictionary for string columns: ids are ranks in the sorted
+// set of distinct values, so id(a) < id(b) iff a < b. A string column is
+// sketched over its ids, which turns string predicates into integer ones and
+// keeps boundary-bucket probes to a u32 compare instead of a string compare.
+class StringDictionary {
+public:
+  StringDictionary() = default;
+
+  static StringDictionary build(const StringColumn &col) {
+    std::vector<std::string_view> views;
+    views.reserve(col.size());
+    for (size_t i = 0; i < col.size(); ++i) {
+      views.push_back(col[i]);
+    }
+    std::sort(views.begin(), views.end());
+    views.erase(std::unique(views.begin(), views.end()), views.end());
+    if (views.size() > (uint64_t(1) << 32)) {
+      throw std::runtime_error("StringDictionary::build more than 2^32 distinct values");
+    }
+    StringDictionary d;
+    for (std::string_view v : views) {
+      d.values_.push_back(v);
+    }
+    return d;
+  }
+
+  size_t size() const { return values_.size(); }
+  std::string_view value(uint32_t id) const { return values_[id]; }
+
+  std::vector<uint32_t> encode(const StringColumn &col) const {
+    std::vector<uint32_t> ids(col.size());
+    for (size_t i = 0; i < col.size(); ++i) {
+      auto id = find(col[i]);
+      if (!id) {
+        throw std::runtime_error("StringDictionary::encode value not in dictionary");
+      }
+      ids[i] = *id;
+    }
+    return ids;
+  }
+
+  std::optional<uint32_t> find(std::string_view s) const {
+    uint32_t r = lower_rank(s);
+    if (r < size() && values_[r] == s) {
+      return r;
+    }
+    return std::nullopt;
+  }
+
+  // Number of dictionary entries < s (resp. <= s).
+  uint32_t lower_rank(std::string_view s) const {
+    return static_cast<uint32_t>(lower_bound(s));
+  }
+  uint32_t upper_rank(std::string_view s) const {
+    size_t r = lower_bound(s);
+    if (r < size() && values_[r] == s) {
+      ++r;
+    }
+    return static_cast<uint32_t>(r);
+  }
+
+  // Ids [first, second) of entries starting with prefix.
+  std::pair<uint32_t, uint32_t> prefix_range(std::string_view prefix) const {
+    const uint32_t lo = lower_rank(prefix);
+    std::string succ(prefix);
+    while (!succ.empty() && static_cast<unsigned char>(succ.back()) == 0xFF) {
+      succ.pop_back();
+    }
+    if (succ.empty()) {
+      return {lo, static_cast<uint32_t>(size())};
+    }
+    succ.back() = static_cast<char>(static_cast<unsigned char>(succ.back()) + 1);
+    return {lo, lower_rank(succ)};
+  }
+
+  void save(const std::string &path) const { write_strings(path, values_); }
+
+  static StringDictionary load(const std::string &path) {
+    StringDictionary d;
+    d.values_ = read_strings(path);
+    for (size_t i = 1; i < d.size(); ++i) {
+      if (!(d.values_[i - 1] < d.values_[i])) {
+        throw std::runtime_error("StringDictionary::load entries not sorted");
+      }
+    }
+    return d;
+  }
+
+private:
+  size_t lower_bound(std::string_view s) const {
+    size_t lo = 0, hi = size();
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (values_[mid] < s) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  StringColumn values_;
+};
+
+// String predicates supported on dictionary-encoded columns.
+enum class StringOp { LT, EQ, BETWEEN, PREFIX };
+
+inline StringOp parse_string_op(const std::string &op) {
+  if (op == "lt") return StringOp::LT;
+  if (op == "eq") return StringOp::EQ;
+  if (op == "between") return StringOp::BETWEEN;
+  if (op == "prefix") return StringOp::PREFIX;
+  throw std::runtime_error("unknown string op: " + op);
+}
+
+// Translate a string predicate into a QuerySpec over dictionary ids. Returns
+// nullopt when no row can match (e.g. EQ on a value absent from the column).
+inline std::optional<QuerySpec> translate_string_predicate(const StringDictionary &dict,
+                                                           StringOp op,
+                                                           std::string_view s1,
+                                                           std::string_view s2 = {}) {
+  switch (op) {
+  case StringOp::LT: {
+    const uint32_t r = dict.lower_rank(s1);
+    if (r == 0) {
+      return std::nullopt;
+    }
+    return QuerySpec{QuerySpec::Op::LT, r, 0};
+  }
+  case StringOp::EQ: {
+    auto id = dict.find(s1);
+    if (!id) {
+      return std::nullopt;
+    }
+    return QuerySpec{QuerySpec::Op::EQ, *id, 0};
+  }
+  case StringOp::BETWEEN: {
+    if (s2 < s1) {
+      std::swap(s1, s2);
+    }
+    const uint32_t lo = dict.lower_rank(s1);
+    const uint32_t hi = dict.upper_rank(s2);
+    if (lo >= hi) {
+      return std::nullopt;
+    }
+    return QuerySpec{QuerySpec::Op::BETWEEN, lo, hi - 1u};
+  }
+  case StringOp::PREFIX: {
+    auto [lo, hi] = dict.prefix_range(s1);
+    if (lo >= hi) {
+      return std::nullopt;
+    }
+    return QuerySpec{QuerySpec::Op::BETWEEN, lo, hi - 1u};
+  }
+  }
+  return std::nullopt;
+}
+
+} // namespace csketch
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+
+#include "csketch/aggregate.hpp"
+#include "csketch/scan.hpp"
+
+namespace csketch {
+
+// ---------------------------------------------------------------------
+//  Selectivity estimates for query planners, from the map's per-code stats
+//  alone: neither codes nor base are read. The result equals
+//  approx_aggregate's COUNT over the full-column histogram (stats.rows), so
+//  `rows_lo`/`rows_hi` are guaranteed, but only the constants' codes are
+//  examined; the rest is a sum of per-code row counts.
+// ---------------------------------------------------------------------
+
+struct Selectivity {
+  double rows = 0.0;    // estimated matching rows
+  double rows_lo = 0.0; // guaranteed bounds
+  double rows_hi = 0.0;
+  uint64_t total = 0;   // rows in the column
+
+  double fraction() const { return total ? rows / static_cast<double>(total) : 0.0; }
+  double fraction_lo() const { return total ? rows_lo / static_cast<double>(total) : 0.0; }
+  double fraction_hi() const { return total ? rows_hi / static_cast<double>(total) : 0.0; }
+};
+
+inline Selectivity estimate_selectivity(const LoadedMap &L, const QuerySpec &query) {
+  const CodeStats &st = detail::require_stats(L, "estimate_selectivity");
+  Selectivity s;
+  auto rows_in = [&](size_t from, size_t to) { // exact rows of codes [from, to)
+    uint64_t n = 0;
+    for (size_t c = from; c < to; ++c) {
+      n += st.rows[c];
+    }
+    return n;
+  };
+  const size_t T = st.size();
+  s.total = rows_in(0, T);
+
+  QuerySpec q = query;
+  uint64_t plo = 0, phi = 0;
+  if (!encodable_query(L.art, q) || !detail::key_interval(q, plo, phi)) {
+    return s;
+  }
+
+  // Only the constants' own codes need stats beyond row counts: every code
+  // strictly between or beyond them is definite, so its rows add exactly.
+  using Op = QuerySpec::Op;
+  const DType dtype = parse_dtype(L.dtype);
+  const bool in = q.op == Op::IN; // v1 is unused and may not encode
+  const uint32_t c1 = in ? 0 : NumericCompressionMap::code_of(L.art, q.v1).first;
+  const bool e1 = !in && NumericCompressionMap::is_exact(L.art, q.v1);
+  auto add = [&](uint32_t c, bool definite) {
+    CodeGroup g;
+    if (detail::code_group(st, dtype, c, st.rows[c], definite, &q, plo, phi, g)) {
+      s.rows += g.rows.value;
+      s.rows_lo += g.rows.lo;
+      s.rows_hi += g.rows.hi;
+    }
+  };
+  uint64_t exact_rows = 0;
+  switch (q.op) {
+  case Op::LT:
+  case Op::LE:
+    exact_rows = rows_in(0, c1);
+    if (!e1 || q.op == Op::LE) add(c1, e1);
+    break;
+  case Op::GT:
+  case Op::GE:
+    exact_rows = rows_in(c1 + 1, T);
+    if (!e1 || q.op == Op::GE) add(c1, e1);
+    break;
+  case Op::EQ:
+    add(c1, e1);
+    break;
+  case Op::NE:
+    exact_rows = s.total - st.rows[c1];
+    if (!e1) add(c1, false);
+    break;
+  case Op::BETWEEN: {
+    const uint32_t c2 = NumericCompressionMap::code_of(L.art, q.v2).first;
+    exact_rows = c2 > c1 ? rows_in(c1 + 1, c2) : 0;
+    add(c1, e1);
+    if (c2 != c1) add(c2, NumericCompressionMap::is_exact(L.art, q.v2));
+    break;
+  }
+  case Op::IN:
+    // Values are sorted, so equal codes are adjacent; an exact value means
+    // its code holds nothing else.
+    for (size_t i = 0; i < q.values.size();) {
+      const uint32_t c = NumericCompressionMap::code_of(L.art, q.values[i]).first;
+      bool exact = false;
+      for (; i < q.values.size() && NumericCompressionMap::code_of(L.art, q.values[i]).first == c; ++i) {
+        exact = exact || NumericCompressionMap::is_exact(L.art, q.values[i]);
+      }
+      add(c, exact);
+    }
+    break;
+  }
+  s.rows += static_cast<double>(exact_rows);
+  s.rows_lo += static_cast<double>(exact_rows);
+  s.rows_hi += static_cast<double>(exact_rows);
+  return s;
+}
+
+} // namespace csketch
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+
+#if defined(CSKETCH_HAVE_NUMA)
+#include <numa.h>
+#endif
+
+#include "csketch/parallel.hpp"
+
+namespace csketch {
+
+// ---------------------------------------------------------------------
+//  Column memory: 64-byte aligned buffers for base keys, codes and masks.
+//  Buffers of at least kHugePageBytes are anonymous mappings aligned to
+//  2 MiB, backed by transparent or explicit huge pages per the policy, and
+//  first-touched in parallel so each worker's row range lands on its NUMA
+//  node. All memory handed out is zeroed.
+// ---------------------------------------------------------------------
+
+constexpr size_t kCacheLineBytes = 64;
+constexpr size_t kPageBytes = 4096;
+constexpr size_t kHugePageBytes = size_t(2) << 20;
+
+enum class HugePages { Off, Transparent, Explicit };
+
+struct MemoryPolicy {
+  HugePages huge_pages = HugePages::Transparent;
+  // Workers that first-touch large buffers; match the scan's thread count.
+  unsigned first_touch_threads = 1;
+};
+
+inline MemoryPolicy &memory_policy() {
+  static MemoryPolicy policy;
+  return policy;
+}
+
+inline HugePages parse_huge_pages(const std::string &s) {
+  if (s == "off") return HugePages::Off;
+  if (s == "thp") return HugePages::Transparent;
+  if (s == "explicit") return HugePages::Explicit;
+  throw std::runtime_error("unknown huge page mode: " + s);
+}
+
+// Row range [first, second) owned by worker w of `workers` over n rows. The
+// first-touch pass and static worker loops share this split.
+inline std::pair<size_t, size_t> worker_range(size_t n, unsigned workers, unsigned w) {
+  return {n * w / workers, n * (w + 1) / workers};
+}
+
+inline unsigned numa_node_count() {
+#if defined(CSKETCH_HAVE_NUMA)
+  if (numa_available() >= 0) {
+    return static_cast<unsigned>(numa_max_node() + 1);
+  }
+#endif
+  return 1;
+}
+
+// Run fn(w) for w in [0, workers), one task per worker, with worker w pinned
+// to NUMA node w * nodes / workers for the duration of the task.
+template <class Fn>
+void parallel_for_local(unsigned workers, Fn &&fn) {
+  if (workers == 0) {
+    workers = default_threads();
+  }
+  const unsigned nodes = numa_node_count();
+  parallel_for(workers, workers, [&](size_t w) {
+#if defined(CSKETCH_HAVE_NUMA)
+    if (nodes > 1) {
+      numa_run_on_node(static_cast<int>(w * nodes / workers));
+    }
+#endif
+    fn(static_cast<unsigned>(w));
+#if defined(CSKETCH_HAVE_NUMA)
+    if (nodes > 1) {
+      numa_run_on_node(-1);
+    }
+#endif
+  });
+  (void)nodes;
+}
+
+// Fault in the pages of [p, p + bytes) from the worker that owns them.
+inline void first_touch(void *p, size_t bytes, unsigned workers) {
+  uint8_t *base = static_cast<uint8_t *>(p);
+  const size_t pages = (bytes + kPageBytes - 1) / kPageBytes;
+  parallel_for_local(workers, [&](unsigned w) {
+    const auto r = worker_range(pages, workers, w);
+    for (size_t pg = r.first; pg < r.second; ++pg) {
+      *reinterpret_cast<volatile uint8_t *>(base + pg * kPageBytes) = 0;
+    }
+  });
+}
+
+namespace detail {
+
+inline size_t huge_round(size_t bytes) {
+  return (bytes + kHugePageBytes - 1) & ~(kHugePageBytes - 1);
+}
+
+inline void *map_huge_aligned(size_t len) {
+  const MemoryPolicy &policy = memory_policy();
+  if (policy.huge_pages == HugePages::Explicit) {
+    void *p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+      return p;
+    }
+    // No reserved huge pages: fall back to regular pages + THP.
+  }
+  // Over-map by one huge page and trim so the buffer starts 2 MiB aligned.
+  void *raw = ::mmap(nullptr, len + kHugePageBytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  const uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+  const uintptr_t aligned = (start + kHugePageBytes - 1) & ~uintptr_t(kHugePageBytes - 1);
+  if (aligned > start) {
+    ::munmap(raw, aligned - start);
+  }
+  const uintptr_t tail = start + len + kHugePageBytes - (aligned + len);
+  if (tail) {
+    ::munmap(reinterpret_cast<void *>(aligned + len), tail);
+  }
+  void *p = reinterpret_cast<void *>(aligned);
+  if (policy.huge_pages != HugePages::Off) {
+    ::madvise(p, len, MADV_HUGEPAGE);
+  }
+  return p;
+}
+
+inline void *column_alloc(size_t bytes) {
+  if (bytes < kHugePageBytes) {
+    void *p = ::operator new(bytes ? bytes : 1, std::align_val_t(kCacheLineBytes));
+    std::memset(p, 0, bytes);
+    return p;
+  }
+  const size_t len = huge_round(bytes);
+  void *p = map_huge_aligned(len);
+  const unsigned workers = memory_policy().first_touch_threads;
+  if (workers > 1) {
+    first_touch(p, len, workers);
+  }
+  return p;
+}
+
+// Nesting depth of resize_uninitialized() on this thread.
+inline unsigned &uninitialized_depth() {
+  thread_local unsigned depth = 0;
+  return depth;
+}
+
+inline void column_free(void *p, size_t bytes) noexcept {
+  if (!p) {
+    return;
+  }
+  if (bytes < kHugePageBytes) {
+    ::operator delete(p, std::align_val_t(kCacheLineBytes));
+  } else {
+    ::munmap(p, huge_round(bytes));
+  }
+}
+
+} // namespace detail
+
+// Allocator for column buffers. Elements are value-initialised as in any
+// std::vector, except inside resize_uninitialized() below.
+template <class T>
+class AlignedAllocator {
+public:
+  using value_type = T;
+
+  AlignedAllocator() noexcept = default;
+  template <class U>
+  AlignedAllocator(const AlignedAllocator<U> &) noexcept {}
+
+  T *allocate(size_t n) {
+    if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+      throw std::bad_array_new_length();
+    }
+    return static_cast<T *>(detail::column_alloc(n * sizeof(T)));
+  }
+  void deallocate(T *p, size_t n) noexcept { detail::column_free(p, n * sizeof(T)); }
+
+  template <class U>
+  void construct(U *p) noexcept(noexcept(U())) {
+    if (detail::uninitialized_depth()) {
+      ::new (static_cast<void *>(p)) U;
+    } else {
+      ::new (static_cast<void *>(p)) U();
+    }
+  }
+  template <class U, class... Args>
+  void construct(U *p, Args &&...args) {
+    ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+  }
+};
+
+template <class T, class U>
+bool operator==(const AlignedAllocator<T> &, const AlignedAllocator<U> &) noexcept {
+  return true;
+}
+template <class T, class U>
+bool operator!=(const AlignedAllocator<T> &, const AlignedAllocator<U> &) noexcept {
+  return false;
+}
+
+template <class T>
+using ColumnVector = std::vector<T, AlignedAllocator<T>>;
+
+// Resize without value-initialising new elements, for buffers about to be
+// overwritten: large buffers stay untouched for first_touch() and the
+// workers that fill them. Elements that come from a fresh allocation are zero
+// (column memory is handed out zeroed); elements in capacity that was used
+// before keep stale values.
+template <class T>
+void resize_uninitialized(ColumnVector<T> &v, size_t n) {
+  struct Scope {
+    Scope() { ++detail::uninitialized_depth(); }
+    ~Scope() { --detail::uninitialized_depth(); }
+  } scope;
+  v.resize(n);
+}
+
+} // namespace csketch
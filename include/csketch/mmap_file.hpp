@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace csketch {
+
+// Read-only memory mapping of a whole file (POSIX). Empty files map to a
+// null pointer with size 0.
+class MappedFile {
+public:
+  MappedFile() = default;
+
+  explicit MappedFile(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("MappedFile: cannot open " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw std::runtime_error("MappedFile: cannot stat " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+      void *p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("MappedFile: mmap failed for " + path);
+      }
+      data_ = static_cast<const uint8_t *>(p);
+    }
+    ::close(fd);
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&o) noexcept { swap(o); }
+  MappedFile &operator=(MappedFile &&o) noexcept {
+    if (this != &o) {
+      unmap();
+      swap(o);
+    }
+    return *this;
+  }
+  ~MappedFile() { unmap(); }
+
+  const uint8_t *data() const { return data_; }
+  size_t size() const { return size_; }
+
+  // Hint that the mapping will be read front to back.
+  void advise_sequential() const {
+    if (data_) {
+      ::madvise(const_cast<uint8_t *>(data_), size_, MADV_SEQUENTIAL);
+    }
+  }
+
+private:
+  void swap(MappedFile &o) {
+    std::swap(data_, o.data_);
+    std::swap(size_, o.size_);
+  }
+  void unmap() {
+    if (data_) {
+      ::munmap(const_cast<uint8_t *>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+} // namespace csketch
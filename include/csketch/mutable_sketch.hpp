@@ -0,0 +1,236 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "csketch/aggregate.hpp"
+#include "csketch/bitvector.hpp"
+#include "csketch/column.hpp"
+#include "csketch/compression_map.hpp"
+#include "csketch/memory.hpp"
+#include "csketch/parallel.hpp"
+#include "csketch/push_scan.hpp"
+#include "csketch/scan.hpp"
+#include "csketch/sketch.hpp"
+
+namespace csketch {
+
+// ---------------------------------------------------------------------
+//  Deletes and in-place updates on an encoded column, at O(changed rows)
+//  instead of a rebuild. A delete sets the row in a tombstone bitmap that
+//  scan() and scan_push() mask out inside the kernels (tombstoned rows are
+//  never probed); an update re-encodes the new key with code_of() and
+//  patches the code and the base key. The map stays valid for any key it
+//  can encode: codes remain order-preserving and is_exact() already allows
+//  for unseen keys. A map without range endpoints (every distinct value got
+//  its own code) can only encode its uniques, so update() rejects other keys.
+//
+//  Other scans (scan_blocked, scan_partitioned, scan_stream) take no
+//  tombstones from here; save() writes the patched column and its bitmap
+//  for run_query --deleted.
+//
+//  Map stats describe the stored rows, tombstoned ones included, so code
+//  histogram consumers (top_k, approximate aggregates) see deleted rows
+//  until compact(); an update only widens min/max. compact() drops the
+//  tombstoned rows, renumbering survivors in order, and recomputes stats.
+// ---------------------------------------------------------------------
+
+class MutableSketch {
+public:
+  // Copies codes[0, N) and keys[0, N) into owned, mutable column memory.
+  MutableSketch(LoadedMap map, const void *codes, const uint64_t *keys, size_t N, unsigned threads = 1)
+      : map_(std::move(map)), dtype_(parse_dtype(map_.dtype)), tombstones_(N) {
+    sk_.code_bits = map_.code_bits;
+    if (sk_.code_bits == 8) {
+      resize_uninitialized(sk_.codes8, N);
+      std::memcpy(sk_.codes8.data(), codes, N);
+    } else if (sk_.code_bits == 16) {
+      resize_uninitialized(sk_.codes16, N);
+      std::memcpy(sk_.codes16.data(), codes, N * sizeof(uint16_t));
+    } else {
+      throw std::invalid_argument("MutableSketch: code_bits must be 8 or 16");
+    }
+    resize_uninitialized(keys_, N);
+    std::memcpy(keys_.data(), keys, N * sizeof(uint64_t));
+    sk_.code_rows = map_.stats.empty()
+                        ? code_histogram(sk_.data(), codes16(), N, map_.art.total_codes, threads)
+                        : map_.stats.rows;
+    if (sk_.code_rows.size() != map_.art.total_codes) {
+      throw std::invalid_argument("MutableSketch: map stats do not match the map");
+    }
+  }
+
+  size_t size() const { return keys_.size(); }
+  uint64_t deleted_rows() const { return deleted_; }
+  double deleted_fraction() const { return size() ? double(deleted_) / double(size()) : 0.0; }
+
+  bool codes16() const { return sk_.code_bits == 16; }
+  const void *codes() const { return sk_.data(); }
+  const EncodedSketch &sketch() const { return sk_; }
+  const ColumnVector<uint64_t> &keys() const { return keys_; }
+  const BitVector &tombstones() const { return tombstones_; }
+  const LoadedMap &map() const { return map_; }
+
+  // Marks a row deleted; false if it already was.
+  bool erase(uint64_t row) {
+    check_row(row);
+    if (tombstones_.get(row)) {
+      return false;
+    }
+    tombstones_.set(row);
+    ++deleted_;
+    return true;
+  }
+
+  // Replaces a live row's key. Returns code_of()'s boundary flag for it.
+  bool update(uint64_t row, uint64_t key) {
+    check_row(row);
+    if (tombstones_.get(row)) {
+      throw std::invalid_argument("MutableSketch::update: row is deleted");
+    }
+    if (map_.art.endpoints.empty() &&
+        !std::binary_search(map_.art.uniques.begin(), map_.art.uniques.end(), key)) {
+      throw std::invalid_argument("MutableSketch::update: the map has no ranges, so it only encodes its "
+                                  "uniques; rebuild the map to store new keys");
+    }
+    const auto [code, boundary] = NumericCompressionMap::code_of(map_.art, key);
+    const uint32_t old = codes16() ? sk_.codes16[row] : sk_.codes8[row];
+    if (codes16()) {
+      sk_.codes16[row] = static_cast<uint16_t>(code);
+    } else {
+      sk_.codes8[row] = static_cast<uint8_t>(code);
+    }
+    --sk_.code_rows[old];
+    ++sk_.code_rows[code];
+
+    CodeStats &st = map_.stats;
+    if (!st.empty()) {
+      --st.rows[old];
+      st.sum[old] -= key_value(keys_[row], dtype_);
+      if (st.rows[code]++ == 0) {
+        st.min_key[code] = st.max_key[code] = key;
+      } else {
+        st.min_key[code] = std::min(st.min_key[code], key);
+        st.max_key[code] = std::max(st.max_key[code], key);
+      }
+      st.sum[code] += key_value(key, dtype_);
+    }
+    keys_[row] = key;
+    return boundary;
+  }
+
+  BitVector scan(const QuerySpec &q) const {
+    return scan_predicate(map_, codes(), codes16(), keys_.data(), size(), q, &tombstones_);
+  }
+
+  // scan_push over the live rows; opt.deleted is replaced by the tombstones.
+  template <class Consumer>
+  void scan_push(const QuerySpec &q, Consumer &&consume, PushOptions opt = PushOptions{}) const {
+    opt.deleted = &tombstones_;
+    csketch::scan_push(map_, codes(), codes16(), keys_.data(), size(), q, std::forward<Consumer>(consume), opt);
+  }
+
+  // Writes <base>.bin (keys as the map's dtype), <base>.sketch,
+  // <base>.map.json (with the current stats) and <base>.deleted.bin, the
+  // tombstones for run_query --deleted.
+  void save(const std::string &base) const {
+    write_column_keys(base + ".bin", keys_, dtype_);
+    save_sketch(sk_, base + ".sketch");
+    save_map_json(map_.art, base + ".map.json", map_.dtype, map_.code_bits, map_.stats);
+    tombstones_.save(base + ".deleted.bin");
+  }
+
+  // Drops tombstoned rows from codes and keys, keeping survivors in row
+  // order, and recomputes exact stats. Returns the rows removed.
+  size_t compact(unsigned threads = 1) {
+    if (deleted_ == 0) {
+      return 0;
+    }
+    if (threads == 0) {
+      threads = default_threads();
+    }
+    const size_t words = (size() + 63) >> 6;
+    const uint64_t *dead = tombstones_.words().data();
+    const size_t tasks = std::max<size_t>(1, std::min<size_t>(threads, size() / 65536 + 1));
+
+    // Survivors per task give each task its output offset.
+    std::vector<size_t> start(tasks + 1, 0);
+    parallel_for(tasks, static_cast<unsigned>(tasks), [&](size_t t) {
+      const auto [w_begin, w_end] = worker_range(words, static_cast<unsigned>(tasks), static_cast<unsigned>(t));
+      size_t live = 0;
+      for (size_t w = w_begin; w < w_end; ++w) {
+        live += static_cast<size_t>(__builtin_popcountll(~dead[w] & valid_bits(w)));
+      }
+      start[t + 1] = live;
+    });
+    for (size_t t = 0; t < tasks; ++t) {
+      start[t + 1] += start[t];
+    }
+
+    const size_t live = start[tasks];
+    EncodedSketch sk;
+    sk.code_bits = sk_.code_bits;
+    if (codes16()) {
+      resize_uninitialized(sk.codes16, live);
+    } else {
+      resize_uninitialized(sk.codes8, live);
+    }
+    ColumnVector<uint64_t> keys;
+    resize_uninitialized(keys, live);
+    parallel_for(tasks, static_cast<unsigned>(tasks), [&](size_t t) {
+      const auto [w_begin, w_end] = worker_range(words, static_cast<unsigned>(tasks), static_cast<unsigned>(t));
+      size_t out = start[t];
+      for (size_t w = w_begin; w < w_end; ++w) {
+        uint64_t bits = ~dead[w] & valid_bits(w);
+        while (bits) {
+          const size_t row = (w << 6) + static_cast<size_t>(__builtin_ctzll(bits));
+          if (codes16()) {
+            sk.codes16[out] = sk_.codes16[row];
+          } else {
+            sk.codes8[out] = sk_.codes8[row];
+          }
+          keys[out++] = keys_[row];
+          bits &= bits - 1;
+        }
+      }
+    });
+
+    sk.code_rows = code_histogram(sk.data(), codes16(), live, map_.art.total_codes, threads);
+    if (!map_.stats.empty()) {
+      map_.stats = code_stats(sk, keys.data(), live, dtype_, threads);
+    }
+    const size_t removed = size() - live;
+    sk_ = std::move(sk);
+    keys_ = std::move(keys);
+    tombstones_ = BitVector(live);
+    deleted_ = 0;
+    return removed;
+  }
+
+private:
+  void check_row(uint64_t row) const {
+    if (row >= size()) {
+      throw std::out_of_range("MutableSketch: row out of range");
+    }
+  }
+
+  // Bits of mask word w that hold rows (all but the ragged last word).
+  uint64_t valid_bits(size_t w) const {
+    const size_t rest = size() - (w << 6);
+    return rest >= 64 ? ~0ULL : (1ULL << rest) - 1;
+  }
+
+  LoadedMap map_;
+  DType dtype_;
+  EncodedSketch sk_;
+  ColumnVector<uint64_t> keys_;
+  BitVector tombstones_;
+  uint64_t deleted_ = 0;
+};
+
+} // namespace csketch
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "csketch/memory.hpp"
+
+namespace csketch {
+
+// ---------------------------------------------------------------------
+//  Frame-of-reference bitpacked key column. Rows are cut into blocks of
+//  kPackBlockRows; each block stores its minimum key and packs (key - min)
+//  in the fewest bits that hold the block's range. Any row decodes in O(1)
+//  from its block header and at most two words, so boundary probes and
+//  full-scan fallbacks read the compressed form directly.
+//
+//  On disk (.packed): u64 rows, u64 n_blocks, u64 n_words, then
+//  {u64 ref, u64 word_offset << 8 | bits} per block, then the words.
+// ---------------------------------------------------------------------
+
+constexpr size_t kPackBlockShift = 9;
+constexpr size_t kPackBlockRows = size_t(1) << kPackBlockShift; // 512
+
+class PackedColumn {
+public:
+  PackedColumn() = default;
+
+  template <class Alloc>
+  static PackedColumn pack(const std::vector<uint64_t, Alloc> &keys) {
+    return pack(keys.data(), keys.size());
+  }
+
+  static PackedColumn pack(const uint64_t *keys, size_t n) {
+    PackedColumn pc;
+    pc.rows_ = n;
+    const size_t nblocks = (n + kPackBlockRows - 1) / kPackBlockRows;
+    pc.blocks_.resize(nblocks);
+    uint64_t words = 0;
+    for (size_t b = 0; b < nblocks; ++b) {
+      const size_t begin = b * kPackBlockRows;
+      const size_t end = std::min(n, begin + kPackBlockRows);
+      auto mm = std::minmax_element(keys + begin, keys + end);
+      const uint64_t range = *mm.second - *mm.first;
+      const unsigned bits = range ? 64u - static_cast<unsigned>(__builtin_clzll(range)) : 0u;
+      pc.blocks_[b] = {*mm.first, (words << 8) | bits};
+      words += ((end - begin) * bits + 63) / 64;
+    }
+    pc.words_.resize(words + 1); // one pad word so a probe may always read w[1]
+
+    for (size_t b = 0; b < nblocks; ++b) {
+      const unsigned bits = pc.blocks_[b].bits();
+      if (bits == 0) {
+        continue;
+      }
+      uint64_t *w = pc.words_.data() + pc.blocks_[b].word();
+      const size_t begin = b * kPackBlockRows;
+      const size_t end = std::min(n, begin + kPackBlockRows);
+      uint64_t bitpos = 0;
+      for (size_t i = begin; i < end; ++i, bitpos += bits) {
+        const uint64_t v = keys[i] - pc.blocks_[b].ref;
+        const unsigned sh = static_cast<unsigned>(bitpos & 63);
+        w[bitpos >> 6] |= v << sh;
+        if (sh + bits > 64) {
+          w[(bitpos >> 6) + 1] |= v >> (64 - sh);
+        }
+      }
+    }
+    return pc;
+  }
+
+  size_t size() const { return rows_; }
+
+  uint64_t operator[](size_t i) const {
+    const Block &b = blocks_[i >> kPackBlockShift];
+    const unsigned bits = b.bits();
+    if (bits == 0) {
+      return b.ref;
+    }
+    const uint64_t bitpos = static_cast<uint64_t>(i & (kPackBlockRows - 1)) * bits;
+    const uint64_t *w = words_.data() + b.word() + (bitpos >> 6);
+    const unsigned sh = static_cast<unsigned>(bitpos & 63);
+    uint64_t v = w[0] >> sh;
+    if (sh + bits > 64) {
+      v |= w[1] << (64 - sh);
+    }
+    if (bits < 64) {
+      v &= (uint64_t(1) << bits) - 1;
+    }
+    return b.ref + v;
+  }
+
+  // Decode rows [begin, end) into out.
+  void decode(size_t begin, size_t end, uint64_t *out) const {
+    for (size_t i = begin; i < end; ++i) {
+      out[i - begin] = (*this)[i];
+    }
+  }
+
+  size_t bytes() const { return blocks_.size() * sizeof(Block) + words_.size() * sizeof(uint64_t); }
+
+  void save(const std::string &path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+      throw std::runtime_error("PackedColumn::save: cannot open file");
+    }
+    const uint64_t hdr[3] = {rows_, blocks_.size(), words_.size()};
+    out.write(reinterpret_cast<const char *>(hdr), sizeof(hdr));
+    out.write(reinterpret_cast<const char *>(blocks_.data()),
+              static_cast<std::streamsize>(blocks_.size() * sizeof(Block)));
+    out.write(reinterpret_cast<const char *>(words_.data()),
+              static_cast<std::streamsize>(words_.size() * sizeof(uint64_t)));
+    if (!out) {
+      throw std::runtime_error("PackedColumn::save: write failed");
+    }
+  }
+
+  static PackedColumn load(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+      throw std::runtime_error("PackedColumn::load: cannot open file");
+    }
+    uint64_t hdr[3] = {0, 0, 0};
+    in.read(reinterpret_cast<char *>(hdr), sizeof(hdr));
+    if (!in || hdr[1] != (hdr[0] + kPackBlockRows - 1) / kPackBlockRows || hdr[2] == 0) {
+      throw std::runtime_error("PackedColumn::load: bad header");
+    }
+    PackedColumn pc;
+    pc.rows_ = hdr[0];
+    pc.blocks_.resize(hdr[1]);
+    pc.words_.resize(hdr[2]);
+    in.read(reinterpret_cast<char *>(pc.blocks_.data()),
+            static_cast<std::streamsize>(pc.blocks_.size() * sizeof(Block)));
+    in.read(reinterpret_cast<char *>(pc.words_.data()),
+            static_cast<std::streamsize>(pc.words_.size() * sizeof(uint64_t)));
+    if (!in) {
+      throw std::runtime_error("PackedColumn::load: truncated file");
+    }
+    for (size_t b = 0; b < pc.blocks_.size(); ++b) {
+      const size_t rows = std::min<uint64_t>(kPackBlockRows, pc.rows_ - b * kPackBlockRows);
+      const unsigned bits = pc.blocks_[b].bits();
+      const uint64_t need = (rows * bits + 63) / 64;
+      if (bits > 64 || (bits && pc.blocks_[b].word() + need + 1 > pc.words_.size())) {
+        throw std::runtime_error("PackedColumn::load: block out of bounds");
+      }
+    }
+    return pc;
+  }
+
+private:
+  struct Block {
+    uint64_t ref;       // block minimum
+    uint64_t word_bits; // word offset << 8 | bit width
+    uint64_t word() const { return word_bits >> 8; }
+    unsigned bits() const { return static_cast<unsigned>(word_bits & 0xFF); }
+  };
+
+  uint64_t rows_ = 0;
+  std::vector<Block> blocks_;
+  ColumnVector<uint64_t> words_;
+};
+
+} // namespace csketch
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace csketch {
+
+inline unsigned default_threads() {
+  unsigned n = std::thread::hardware_concurrency();
+  return n ? n : 1;
+}
+
+// Run fn(task) for task in [0, tasks) on up to `threads` workers. Tasks are
+// handed out dynamically; the first exception thrown by a task is rethrown
+// on the caller once all workers have stopped.
+template <class Fn>
+void parallel_for(size_t tasks, unsigned threads, Fn &&fn) {
+  if (threads == 0) {
+    threads = default_threads();
+  }
+  if (tasks == 0) {
+    return;
+  }
+  if (threads == 1 || tasks == 1) {
+    for (size_t t = 0; t < tasks; ++t) {
+      fn(t);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next{0};
+  std::exception_ptr error;
+  std::mutex error_mu;
+  auto worker = [&]() {
+    for (;;) {
+      const size_t t = next.fetch_add(1, std::memory_order_relaxed);
+      if (t >= tasks) {
+        return;
+      }
+      try {
+        fn(t);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mu);
+        if (!error) {
+          error = std::current_exception();
+        }
+        next.store(tasks, std::memory_order_relaxed);
+      }
+    }
+  };
+
+  const size_t n = std::min<size_t>(threads, tasks);
+  std::vector<std::thread> pool;
+  pool.reserve(n - 1);
+  for (size_t i = 1; i < n; ++i) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto &th : pool) {
+    th.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+} // namespace csketch
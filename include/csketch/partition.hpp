@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "csketch/bitvector.hpp"
+#include "csketch/compression_map.hpp"
+#include "csketch/parallel.hpp"
+#include "csketch/scan.hpp"
+#include "csketch/sketch.hpp"
+
+namespace csketch {
+
+// ---------------------------------------------------------------------
+//  Partitioned sketches: the column is cut into fixed-size row ranges, each
+//  with a locally fitted map. Codes of all partitions share one width and
+//  live back to back in a single .sketch file; the manifest records each
+//  partition's rows, key range and map file.
+// ---------------------------------------------------------------------
+
+struct PartitionInfo {
+    uint64_t row_begin = 0;
+    uint64_t rows = 0;
+    uint64_t min_key = 0;
+    uint64_t max_key = 0;
+    std::string map_path; // relative to the manifest's directory
+    LoadedMap map;
+};
+
+struct Manifest {
+    std::string dtype;
+    uint32_t code_bits = 8;
+    uint64_t rows = 0;
+    uint64_t partition_rows = 0;
+    std::vector<PartitionInfo> parts;
+};
+
+inline std::string manifest_dir(const std::string& path) {
+    auto slash = path.find_last_of('/');
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+inline std::string path_basename(const std::string& path) {
+    auto slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// Build per-partition maps with `build_map` (called concurrently) and encode
+// all partitions into one code array. partition_rows is rounded up to a
+// multiple of 64 so every partition starts on a mask word.
+inline std::pair<Manifest, EncodedSketch> build_partitioned(
+        const ColumnVector<uint64_t>& keys, uint64_t partition_rows, uint32_t max_codes,
+        const std::string& dtype,
+        const std::function<MapArtifacts(const std::vector<uint64_t>&)>& build_map,
+        unsigned threads = 1) {
+    if (keys.empty()) throw std::invalid_argument("build_partitioned: empty column");
+    if (partition_rows == 0) throw std::invalid_argument("build_partitioned: partition_rows must be > 0");
+    partition_rows = (partition_rows + 63) & ~uint64_t(63);
+
+    const uint64_t N = keys.size();
+    const size_t nparts = static_cast<size_t>((N + partition_rows - 1) / partition_rows);
+
+    Manifest m;
+    m.dtype = dtype;
+    m.rows = N;
+    m.partition_rows = partition_rows;
+    m.code_bits = code_bits_for(std::min<uint32_t>(max_codes, 65536));
+    m.parts.resize(nparts);
+
+    EncodedSketch all;
+    all.code_bits = m.code_bits;
+    if (all.code_bits == 8) resize_uninitialized(all.codes8, N); else resize_uninitialized(all.codes16, N);
+    std::vector<size_t> hits(nparts, 0);
+
+    parallel_for(nparts, threads, [&](size_t p) {
+        PartitionInfo& part = m.parts[p];
+        part.row_begin = p * partition_rows;
+        part.rows = std::min<uint64_t>(partition_rows, N - part.row_begin);
+        std::vector<uint64_t> local(keys.begin() + part.row_begin,
+                                    keys.begin() + part.row_begin + part.rows);
+        auto mm = std::minmax_element(local.begin(), local.end());
+        part.min_key = *mm.first;
+        part.max_key = *mm.second;
+        part.map.art = build_map(local);
+        part.map.dtype = dtype;
+        part.map.code_bits = m.code_bits;
+        EncodedSketch sk = encode_sketch(part.map.art, local, 1, m.code_bits);
+        if (m.code_bits == 8) {
+            std::copy(sk.codes8.begin(), sk.codes8.end(), all.codes8.begin() + part.row_begin);
+        } else {
+            std::copy(sk.codes16.begin(), sk.codes16.end(), all.codes16.begin() + part.row_begin);
+        }
+        hits[p] = sk.boundary_hits;
+    });
+    for (size_t h : hits) all.boundary_hits += h;
+    return {std::move(m), std::move(all)};
+}
+
+// Writes <base>.manifest.json plus one <base>.p<k>.map.json per partition.
+inline std::string save_manifest(Manifest& m, const std::string& base) {
+    const std::string manifest_path = base + ".manifest.json";
+    for (size_t p = 0; p < m.parts.size(); ++p) {
+        const std::string map_path = base + ".p" + std::to_string(p) + ".map.json";
+        save_map_json(m.parts[p].map.art, map_path, m.dtype, m.code_bits);
+        m.parts[p].map_path = path_basename(map_path);
+    }
+    std::ofstream out(manifest_path);
+    if (!out) throw std::runtime_error("save_manifest: cannot open file");
+    out << "{\n";
+    out << " \"map_format\": " << kMapFormat << ",\n";
+    out << " \"dtype\": \"" << m.dtype << "\",\n";
+    out << " \"code_bits\": " << m.code_bits << ",\n";
+    out << " \"rows\": " << m.rows << ",\n";
+    out << " \"partition_rows\": " << m.partition_rows << ",\n";
+    out << " \"partitions\": [\n";
+    for (size_t p = 0; p < m.parts.size(); ++p) {
+        const auto& part = m.parts[p];
+        out << "  {\"row_begin\": " << part.row_begin << ", \"rows\": " << part.rows
+            << ", \"min\": " << part.min_key << ", \"max\": " << part.max_key
+            << ", \"map\": \"" << part.map_path << "\"}" << (p + 1 < m.parts.size() ? ",\n" : "\n");
+    }
+    out << " ]\n}";
+    return manifest_path;
+}
+
+inline Manifest load_manifest(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("load_manifest: cannot open file");
+    std::string s((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    auto value_after = [&](const std::string& key, size_t from, size_t& at) -> std::string {
+        auto k = s.find("\"" + key + "\"", from);
+        if (k == std::string::npos) throw std::runtime_error("load_manifest: missing " + key);
+        auto c = s.find(':', k);
+        auto a = s.find_first_not_of(" \t\r\n\"", c + 1);
+        auto b = s.find_first_of(",\n}\"", a);
+        at = b;
+        return s.substr(a, b - a);
+    };
+
+    Manifest m;
+    size_t at = 0;
+    if (s.find("\"map_format\"") == std::string::npos)
+        throw std::runtime_error("load_manifest: manifest has no map format (built before order-preserving codes); rebuild it with build_sketch");
+    if (std::stoul(value_after("map_format", 0, at)) != kMapFormat)
+        throw std::runtime_error("load_manifest: unsupported map format");
+    m.dtype = value_after("dtype", 0, at);
+    m.code_bits = static_cast<uint32_t>(std::stoul(value_after("code_bits", 0, at)));
+    m.rows = std::stoull(value_after("rows", 0, at));
+    m.partition_rows = std::stoull(value_after("partition_rows", 0, at));
+    if (m.partition_rows == 0 || m.partition_rows % 64 != 0) {
+        throw std::runtime_error("load_manifest: partition_rows must be a positive multiple of 64");
+    }
+
+    const std::string dir = manifest_dir(path);
+    size_t pos = s.find("\"partitions\"");
+    uint64_t expect_begin = 0;
+    while ((pos = s.find("\"row_begin\"", pos)) != std::string::npos) {
+        PartitionInfo part;
+        part.row_begin = std::stoull(value_after("row_begin", pos, at));
+        part.rows = std::stoull(value_after("rows", pos, at));
+        part.min_key = std::stoull(value_after("min", pos, at));
+        part.max_key = std::stoull(value_after("max", pos, at));
+        part.map_path = value_after("map", pos, at);
+        pos = at;
+        if (part.row_begin != expect_begin) {
+            throw std::runtime_error("load_manifest: partitions are not contiguous");
+        }
+        expect_begin += part.rows;
+        part.map = load_map_json(dir + part.map_path);
+        if (part.map.code_bits != m.code_bits) {
+            throw std::runtime_error("load_manifest: partition code width mismatch");
+        }
+        m.parts.push_back(std::move(part));
+    }
+    if (expect_begin != m.rows) throw std::runtime_error("load_manifest: partitions do not cover all rows");
+    return m;
+}
+
+// Scan every partition with its own map, translating the predicate constants
+// through that map. Partitions whose [min, max] decides the predicate are
+// filled or skipped without touching codes.
+inline BitVector scan_partitioned(const Manifest& m, const void* codes,
+                                  const uint64_t* base, size_t N,
+                                  const QuerySpec& q, unsigned threads = 1) {
+    if (N != m.rows) throw std::invalid_argument("scan_partitioned: base length does not match manifest");
+    BitVector out(N);
+    uint64_t* W = out.words().data();
+    const bool codes16 = (m.code_bits == 16);
+
+    parallel_for(m.parts.size(), threads, [&](size_t p) {
+        const PartitionInfo& part = m.parts[p];
+        const size_t w0 = static_cast<size_t>(part.row_begin >> 6);
+        const size_t nwords = static_cast<size_t>((part.rows + 63) >> 6);
+
+        bool none = false, all = false;
+        switch (q.op) {
+        case QuerySpec::Op::LT:
+            all = part.max_key < q.v1;
+            none = part.min_key >= q.v1;
+            break;
+        case QuerySpec::Op::EQ:
+            none = q.v1 < part.min_key || q.v1 > part.max_key;
+            all = part.min_key == q.v1 && part.max_key == q.v1;
+            break;
+        case QuerySpec::Op::BETWEEN:
+            none = q.v2 < part.min_key || q.v1 > part.max_key;
+            all = q.v1 <= part.min_key && part.max_key <= q.v2;
+            break;
+        case QuerySpec::Op::GT:
+            all = part.min_key > q.v1;
+            none = part.max_key <= q.v1;
+            break;
+        case QuerySpec::Op::GE:
+            all = part.min_key >= q.v1;
+            none = part.max_key < q.v1;
+            break;
+        case QuerySpec::Op::LE:
+            all = part.max_key <= q.v1;
+            none = part.min_key > q.v1;
+            break;
+        case QuerySpec::Op::NE:
+            all = q.v1 < part.min_key || q.v1 > part.max_key;
+            none = part.min_key == q.v1 && part.max_key == q.v1;
+            break;
+        case QuerySpec::Op::IN: {
+            auto it = std::lower_bound(q.values.begin(), q.values.end(), part.min_key);
+            none = it == q.values.end() || *it > part.max_key;
+            all = part.min_key == part.max_key && !none;
+            break;
+        }
+        }
+        if (none) return;
+        if (all) {
+            std::fill(W + w0, W + w0 + nwords, ~0ULL);
+            if (part.rows & 63) W[w0 + nwords - 1] = (1ULL << (part.rows & 63)) - 1;
+            return;
+        }
+
+        // A partition of few distinct values may have no ranges: constants
+        // it does not store move onto its own stored values, per partition.
+        QuerySpec pq = q;
+        if (!encodable_query(part.map.art, pq)) return;
+        const void* pc = codes16
+            ? static_cast<const void*>(static_cast<const uint16_t*>(codes) + part.row_begin)
+            : static_cast<const void*>(static_cast<const uint8_t*>(codes) + part.row_begin);
+        BitVector local = scan_predicate(part.map, pc, codes16, base + part.row_begin,
+                                         static_cast<size_t>(part.rows), pq);
+        std::memcpy(W + w0, local.words().data(), nwords * sizeof(uint64_t));
+    });
+    return out;
+}
+
+} // namespace csketch
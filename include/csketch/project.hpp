@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define CSKETCH_X86_DISPATCH 1
+#endif
+
+#include "csketch/bitvector.hpp"
+#include "csketch/parallel.hpp"
+
+namespace csketch {
+
+// ---------------------------------------------------------------------
+//  Late materialization: turn a scan result into row ids and compacted
+//  column values. Work is split into blocks of mask words; a popcount pass
+//  gives each block its output offset so blocks fill in parallel.
+// ---------------------------------------------------------------------
+
+namespace detail {
+
+constexpr size_t kProjectBlockWords = 4096; // 256Ki rows per block
+
+inline std::vector<uint64_t> block_offsets(const BitVector &mask, size_t blocks,
+                                           unsigned threads) {
+  const auto &W = mask.words();
+  std::vector<uint64_t> off(blocks + 1, 0);
+  parallel_for(blocks, threads, [&](size_t b) {
+    const size_t end = std::min(W.size(), (b + 1) * kProjectBlockWords);
+    uint64_t c = 0;
+    for (size_t w = b * kProjectBlockWords; w < end; ++w) {
+      c += static_cast<uint64_t>(__builtin_popcountll(W[w]));
+    }
+    off[b + 1] = c;
+  });
+  for (size_t b = 0; b < blocks; ++b) {
+    off[b + 1] += off[b];
+  }
+  return off;
+}
+
+template <class T>
+size_t compact_words_scalar(const uint64_t *W, size_t w_begin, size_t w_end, const T *col,
+                            T *out) {
+  size_t k = 0;
+  for (size_t w = w_begin; w < w_end; ++w) {
+    uint64_t bits = W[w];
+    const size_t base = w << 6;
+    if (bits == ~0ULL) {
+      for (size_t j = 0; j < 64; ++j) {
+        out[k + j] = col[base + j];
+      }
+      k += 64;
+      continue;
+    }
+    while (bits) {
+      out[k++] = col[base + static_cast<size_t>(__builtin_ctzll(bits))];
+      bits &= bits - 1;
+    }
+  }
+  return k;
+}
+
+#if defined(CSKETCH_X86_DISPATCH)
+// 8 mask bits select 8 lanes; vpcompressq packs them contiguously.
+__attribute__((target("avx512f"))) inline size_t
+compact_words_avx512(const uint64_t *W, size_t w_begin, size_t w_end, const uint64_t *col,
+                     uint64_t *out) {
+  size_t k = 0;
+  for (size_t w = w_begin; w < w_end; ++w) {
+    const uint64_t bits = W[w];
+    if (bits == 0) {
+      continue;
+    }
+    const uint64_t *src = col + (w << 6);
+    for (size_t j = 0; j < 8; ++j) {
+      const __mmask8 m = static_cast<__mmask8>(bits >> (8 * j));
+      if (m == 0) {
+        continue;
+      }
+      const __m512i v = _mm512_maskz_loadu_epi64(m, src + 8 * j); // no tail overread
+      _mm512_mask_compressstoreu_epi64(out + k, m, v);
+      k += static_cast<size_t>(__builtin_popcount(m));
+    }
+  }
+  return k;
+}
+
+inline bool has_avx512f() {
+  static const bool ok = __builtin_cpu_supports("avx512f");
+  return ok;
+}
+#endif
+
+template <class T>
+size_t compact_words(const uint64_t *W, size_t w_begin, size_t w_end, const T *col, T *out) {
+#if defined(CSKETCH_X86_DISPATCH)
+  if constexpr (sizeof(T) == 8 && std::is_trivially_copyable<T>::value) {
+    if (has_avx512f()) {
+      return compact_words_avx512(W, w_begin, w_end, reinterpret_cast<const uint64_t *>(col),
+                                  reinterpret_cast<uint64_t *>(out));
+    }
+  }
+#endif
+  return compact_words_scalar(W, w_begin, w_end, col, out);
+}
+
+} // namespace detail
+
+// Row ids of the set bits, in ascending order.
+inline std::vector<uint64_t> mask_positions(const BitVector &mask, unsigned threads = 1) {
+  const auto &W = mask.words();
+  const size_t blocks = (W.size() + detail::kProjectBlockWords - 1) / detail::kProjectBlockWords;
+  const auto off = detail::block_offsets(mask, blocks, threads);
+  std::vector<uint64_t> out(off[blocks]);
+  parallel_for(blocks, threads, [&](size_t b) {
+    const size_t end = std::min(W.size(), (b + 1) * detail::kProjectBlockWords);
+    uint64_t *dst = out.data() + off[b];
+    for (size_t w = b * detail::kProjectBlockWords; w < end; ++w) {
+      uint64_t bits = W[w];
+      while (bits) {
+        *dst++ = (static_cast<uint64_t>(w) << 6) + static_cast<uint64_t>(__builtin_ctzll(bits));
+        bits &= bits - 1;
+      }
+    }
+  });
+  return out;
+}
+
+// Values of col[0, n) at the set bits of mask, compacted in row order.
+template <class T>
+std::vector<T> gather(const BitVector &mask, const T *col, size_t n, unsigned threads = 1) {
+  if (mask.size() != n) {
+    throw std::invalid_argument("gather: mask and column lengths differ");
+  }
+  const auto &W = mask.words();
+  const size_t blocks = (W.size() + detail::kProjectBlockWords - 1) / detail::kProjectBlockWords;
+  const auto off = detail::block_offsets(mask, blocks, threads);
+  std::vector<T> out(off[blocks]);
+  parallel_for(blocks, threads, [&](size_t b) {
+    const size_t w_begin = b * detail::kProjectBlockWords;
+    const size_t w_end = std::min(W.size(), w_begin + detail::kProjectBlockWords);
+    detail::compact_words(W.data(), w_begin, w_end, col, out.data() + off[b]);
+  });
+  return out;
+}
+
+template <class T, class Alloc>
+std::vector<T> gather(const BitVector &mask, const std::vector<T, Alloc> &col, unsigned threads = 1) {
+  return gather(mask, col.data(), col.size(), threads);
+}
+
+// Values of col at an ascending (or arbitrary) position list. Rows a fixed
+// distance ahead are prefetched since the accesses are not sequential.
+template <class T, class Alloc>
+std::vector<T> gather(const std::vector<uint64_t> &positions, const std::vector<T, Alloc> &col,
+                      unsigned threads = 1) {
+  constexpr size_t kPrefetch = 16;
+  constexpr size_t kBlock = size_t(1) << 16;
+  const size_t n = positions.size();
+  std::vector<T> out(n);
+  parallel_for((n + kBlock - 1) / kBlock, threads, [&](size_t b) {
+    const size_t end = std::min(n, (b + 1) * kBlock);
+    for (size_t i = b * kBlock; i < end; ++i) {
+      if (i + kPrefetch < end) {
+        __builtin_prefetch(col.data() + positions[i + kPrefetch]);
+      }
+      const uint64_t p = positions[i];
+      if (p >= col.size()) {
+        throw std::out_of_range("gather: position past column end");
+      }
+      out[i] = col[p];
+    }
+  });
+  return out;
+}
+
+// Project several columns of one table through the same mask.
+template <class T, class Alloc>
+std::vector<std::vector<T>> gather_columns(const BitVector &mask,
+                                           const std::vector<const std::vector<T, Alloc> *> &cols,
+                                           unsigned threads = 1) {
+  std::vector<std::vector<T>> out;
+  out.reserve(cols.size());
+  for (const auto *col : cols) {
+    out.push_back(gather(mask, *col, threads));
+  }
+  return out;
+}
+
+} // namespace csketch
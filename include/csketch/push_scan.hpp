@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "csketch/bitvector.hpp"
+#include "csketch/parallel.hpp"
+#include "csketch/scan.hpp"
+
+namespace csketch {
+
+// ---------------------------------------------------------------------
+//  Push-based scans. Instead of materialising an N-bit mask, the column is
+//  scanned in cache-sized morsels and each morsel's result is handed to a
+//  consumer while it is still in cache, so filters, aggregates and
+//  projections can run pipelined with memory bounded by the morsel size.
+//  Workers pull morsels dynamically; with threads > 1 the consumer is
+//  called concurrently (from different workers) and morsels arrive in no
+//  particular order. `worker` indexes per-worker consumer state.
+// ---------------------------------------------------------------------
+
+constexpr size_t kMorselRows = 16384; // 16 KiB of 8-bit codes, 2 KiB of mask
+
+struct PushOptions {
+  size_t morsel_rows = kMorselRows; // rounded up to a multiple of 64
+  unsigned threads = 1;             // 0: hardware concurrency
+  const BitVector *deleted = nullptr; // optional tombstones: set rows never match
+};
+
+// Matches of rows [row, row + rows) as mask words; bits past `rows` are 0.
+struct MaskChunk {
+  uint64_t row = 0;
+  size_t rows = 0;
+  const uint64_t *words = nullptr; // (rows + 63) / 64 words
+  unsigned worker = 0;
+};
+
+// Matching row ids (absolute, ascending) of rows [row, row + rows).
+struct PositionChunk {
+  uint64_t row = 0;
+  size_t rows = 0;
+  const uint64_t *positions = nullptr;
+  size_t count = 0;
+  unsigned worker = 0;
+};
+
+namespace detail {
+
+// Base indexed from a morsel's first row, so kernels see a zero-based column.
+template <class Base>
+struct OffsetBase {
+  const Base &base;
+  size_t offset;
+  uint64_t operator[](size_t i) const { return base[offset + i]; }
+};
+
+inline unsigned push_workers(const PushOptions &opt, size_t morsels) {
+  const unsigned threads = opt.threads ? opt.threads : default_threads();
+  return static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, morsels)));
+}
+
+} // namespace detail
+
+// Number of workers scan_push will use, for sizing per-worker state.
+inline unsigned push_worker_count(size_t N, const PushOptions &opt = PushOptions{}) {
+  const size_t morsel = std::max<size_t>(64, (opt.morsel_rows + 63) & ~size_t(63));
+  return detail::push_workers(opt, (N + morsel - 1) / morsel);
+}
+
+template <class Base, class Consumer>
+void scan_push(const LoadedMap &L, const void *codes, bool codes16, const Base &base, size_t N,
+               const QuerySpec &query, Consumer &&consume, const PushOptions &opt = PushOptions{}) {
+  using Shifted = detail::OffsetBase<Base>;
+  const size_t morsel = std::max<size_t>(64, (opt.morsel_rows + 63) & ~size_t(63));
+  const size_t morsels = (N + morsel - 1) / morsel;
+  const unsigned workers = detail::push_workers(opt, morsels);
+  const size_t code_bytes = codes16 ? 2 : 1;
+  const uint8_t *C = static_cast<const uint8_t *>(codes);
+  if (opt.deleted && opt.deleted->size() != N) {
+    throw std::invalid_argument("scan_push: tombstone bitmap length differs from column");
+  }
+  const uint64_t *dead = opt.deleted ? opt.deleted->words().data() : nullptr;
+
+  // Per-query setup once: kernel and args, or the IN classification table.
+  // A query no row can match still delivers every morsel.
+  QuerySpec q = query;
+  const bool none = !encodable_query(L.art, q);
+  const bool in = q.op == QuerySpec::Op::IN;
+  RangeArgs a;
+  RangeKernel<Shifted> kernel = nullptr;
+  std::vector<uint8_t> cls;
+  if (none) {
+    // every morsel is all zeros
+  } else if (in) {
+    cls = classify_codes(L.art, q);
+  } else {
+    kernel = range_kernel<Shifted>(active_isa(), codes16, q.op, range_args(L.art, q, a));
+  }
+
+  std::atomic<size_t> next{0};
+  parallel_for(workers, workers, [&](size_t w) {
+    std::vector<uint64_t> words(morsel >> 6);
+    for (size_t m = next.fetch_add(1, std::memory_order_relaxed); m < morsels;
+         m = next.fetch_add(1, std::memory_order_relaxed)) {
+      const size_t row = m * morsel;
+      const size_t rows = std::min(morsel, N - row);
+      const Shifted shifted{base, row};
+      // Morsels start on a mask word, so their tombstones start at row / 64.
+      const uint64_t *morsel_dead = dead ? dead + (row >> 6) : nullptr;
+      if (none) {
+        std::fill(words.begin(), words.end(), 0);
+      } else if (in) {
+        detail::classified_scan(cls, C + row * code_bytes, codes16, shifted, rows, q, words.data(),
+                                morsel_dead);
+      } else {
+        RangeArgs ma = a;
+        ma.dead = morsel_dead;
+        kernel(C + row * code_bytes, shifted, rows, ma, words.data());
+      }
+      consume(MaskChunk{row, rows, words.data(), static_cast<unsigned>(w)});
+    }
+  });
+}
+
+// As scan_push, but each morsel's matches are decoded to row ids first.
+template <class Base, class Consumer>
+void scan_push_positions(const LoadedMap &L, const void *codes, bool codes16, const Base &base,
+                         size_t N, const QuerySpec &q, Consumer &&consume,
+                         const PushOptions &opt = PushOptions{}) {
+  std::vector<std::vector<uint64_t>> pos(push_worker_count(N, opt));
+  scan_push(
+      L, codes, codes16, base, N, q,
+      [&](const MaskChunk &c) {
+        std::vector<uint64_t> &p = pos[c.worker];
+        p.clear();
+        for (size_t w = 0; w < (c.rows + 63) / 64; ++w) {
+          uint64_t bits = c.words[w];
+          while (bits) {
+            p.push_back(c.row + (w << 6) + static_cast<uint64_t>(__builtin_ctzll(bits)));
+            bits &= bits - 1;
+          }
+        }
+        consume(PositionChunk{c.row, c.rows, p.data(), p.size(), c.worker});
+      },
+      opt);
+}
+
+} // namespace csketch
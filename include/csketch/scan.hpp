@@ -1,6 +1,8 @@
 #pragma once
 #include <algorithm>
+#include <array>
 #include <cstdint>
+#include <cstdlib>
 #include <fstream>
 #include <stdexcept>
 #include <string>
@@ -8,21 +10,80 @@
 #include <vector>
 
 #include "csketch/bitvector.hpp"
+#include "csketch/column.hpp"
 #include "csketch/compression_map.hpp"
+#include "csketch/packed_column.hpp"
+#include "csketch/simd.hpp"
 
 namespace csketch {
 
 struct QuerySpec {
-    enum class Op { LT, EQ, BETWEEN };
+    enum class Op { LT, EQ, BETWEEN, GT, GE, LE, NE, IN };
     Op op;
-    uint64_t v1 = 0;   // for LT/EQ: the value; for BETWEEN: low
-    uint64_t v2 = 0;   // for BETWEEN: high
+    uint64_t v1 = 0;   // for LT/EQ/GT/GE/LE/NE: the value; for BETWEEN: low (as key)
+    uint64_t v2 = 0;   // for BETWEEN: high (as key)
+    std::vector<uint64_t> values{}; // for IN: sorted, distinct keys
+
+    // Predicate on a single key (base probes and full scans).
+    bool matches(uint64_t k) const {
+        switch (op) {
+        case Op::LT: return k < v1;
+        case Op::EQ: return k == v1;
+        case Op::BETWEEN: return k >= v1 && k <= v2;
+        case Op::GT: return k > v1;
+        case Op::GE: return k >= v1;
+        case Op::LE: return k <= v1;
+        case Op::NE: return k != v1;
+        case Op::IN: return std::binary_search(values.begin(), values.end(), k);
+        }
+        return false;
+    }
 };
 
+inline QuerySpec::Op parse_query_op(const std::string& s) {
+    if (s == "lt") return QuerySpec::Op::LT;
+    if (s == "eq") return QuerySpec::Op::EQ;
+    if (s == "between") return QuerySpec::Op::BETWEEN;
+    if (s == "gt") return QuerySpec::Op::GT;
+    if (s == "ge") return QuerySpec::Op::GE;
+    if (s == "le") return QuerySpec::Op::LE;
+    if (s == "ne") return QuerySpec::Op::NE;
+    if (s == "in") return QuerySpec::Op::IN;
+    throw std::runtime_error("unknown --op: " + s);
+}
+
+// Build a query from CLI literals of the column dtype. BETWEEN bounds are
+// ordered; IN takes a comma-separated list in s1.
+inline QuerySpec make_query(QuerySpec::Op op, const std::string& s1, const std::string& s2, DType t) {
+    QuerySpec q{op, 0, 0};
+    if (op == QuerySpec::Op::IN) {
+        size_t a = 0;
+        while (a <= s1.size()) {
+            size_t b = s1.find(',', a);
+            if (b == std::string::npos) b = s1.size();
+            if (b > a) q.values.push_back(parse_key(s1.substr(a, b - a), t));
+            a = b + 1;
+        }
+        if (q.values.empty()) throw std::runtime_error("make_query: empty IN list");
+        std::sort(q.values.begin(), q.values.end());
+        q.values.erase(std::unique(q.values.begin(), q.values.end()), q.values.end());
+        q.v1 = q.values.front();
+        q.v2 = q.values.back();
+        return q;
+    }
+    q.v1 = parse_key(s1, t);
+    if (op == QuerySpec::Op::BETWEEN) {
+        q.v2 = parse_key(s2.empty() ? "0" : s2, t);
+        if (q.v2 < q.v1) std::swap(q.v1, q.v2);
+    }
+    return q;
+}
+
 struct LoadedMap {
     MapArtifacts art;
-    std::string dtype;    // "u32" or "u64"
+    std::string dtype;    // "u32", "i64", "f64", ... (map values are keys)
     uint32_t code_bits;   // 8 or 16
+    CodeStats stats;      // per-code rows/min/max/sum (empty for older maps)
 };
 
 // --- Minimal JSON loader for .map.json (no external deps) ---
@@ -56,232 +117,516 @@ inline LoadedMap load_map_json(const std::string& path) {
         return out;
     };
 
+    const std::string format = find_str("format");
+    if (format.empty())
+        throw std::runtime_error("load_map_json: map has no format version (built before order-preserving codes); rebuild it with build_sketch");
+    if (std::stoul(format) != kMapFormat)
+        throw std::runtime_error("load_map_json: unsupported map format " + format);
+
     LoadedMap L;
     std::string dtype = find_str("dtype");
-    if (dtype.find("u32")!=std::string::npos) L.dtype = "u32"; else L.dtype = "u64";
+    dtype.erase(dtype.find_last_not_of(" \t\r\n\"") + 1);
+    L.dtype = dtype_name(parse_dtype(dtype));
     L.code_bits = static_cast<uint32_t>(std::stoul(find_str("code_bits")));
     L.art.total_codes = static_cast<uint32_t>(std::stoul(find_str("total_codes")));
     L.art.uniques = find_array("uniques");
     L.art.endpoints = find_array("endpoints");
+
+    // Optional per-code stats; sums are decimal doubles.
+    auto find_doubles = [&](const std::string& key)->std::vector<double> {
+        std::vector<double> out;
+        auto k = s.find("\""+key+"\"");
+        if (k==std::string::npos) return out;
+        auto lb = s.find('[', k); auto rb = s.find(']', lb);
+        if (lb==std::string::npos || rb==std::string::npos) return out;
+        const char* p = s.c_str() + lb + 1;
+        const char* end = s.c_str() + rb;
+        while (p < end) {
+            char* next = nullptr;
+            const double v = std::strtod(p, &next);
+            if (next == p) { ++p; continue; }
+            out.push_back(v);
+            p = next;
+        }
+        return out;
+    };
+    L.stats.rows = find_array("code_rows");
+    if (!L.stats.rows.empty()) {
+        L.stats.min_key = find_array("code_min");
+        L.stats.max_key = find_array("code_max");
+        L.stats.sum = find_doubles("code_sum");
+        const size_t n = L.art.total_codes;
+        if (L.stats.rows.size() != n || L.stats.min_key.size() != n ||
+            L.stats.max_key.size() != n || L.stats.sum.size() != n)
+            throw std::runtime_error("load_map_json: per-code stats do not match total_codes");
+    }
     return L;
 }
 
 // ---------------------------------------------------------------------
-//  Fast path: specialized scan for 8-bit codes (tight loops, no lambdas)
+//  Range kernels, specialized at compile time over
+//    Isa    comparison instruction set (simd.hpp)
+//    Code   uint8_t / uint16_t
+//    op     LT/LE/GT/GE/EQ/NE/BETWEEN
+//    probe  which boundary codes need base probes (none when the constant
+//           is exact, i.e. a unique that owns its code)
+//    Base   anything indexable by row: `const uint64_t*` or PackedColumn
+//  so the hot loop carries no runtime branches on any of them. Codes are
+//  compared 64 at a time into definite / candidate row masks; only the
+//  candidate rows touch the base. range_kernel() picks the instance from a
+//  dispatch table once per query.
 // ---------------------------------------------------------------------
 
-inline BitVector scan_predicate_8bit(const LoadedMap& L,
-                                     const uint8_t* codes,
-                                     const std::vector<uint64_t>& base,
-                                     const QuerySpec& q) {
-    const size_t N = base.size();
-    BitVector out(N);
+enum class Probe { None, Lo, Hi, Both };
 
-    auto code_of_v = [&](uint64_t v){ return NumericCompressionMap::code_of(L.art, v); };
+struct RangeArgs {
+    uint32_t c1 = 0, c2 = 0; // codes of v1, v2
+    uint64_t v1 = 0, v2 = 0; // keys, for probes
+    const uint64_t* dead = nullptr; // optional tombstone words: never match, never probed
+};
 
-    uint32_t c1=0, c2=0;
-    if (q.op == QuerySpec::Op::LT || q.op == QuerySpec::Op::EQ) {
-        c1 = code_of_v(q.v1).first;
-    } else {
-        c1 = code_of_v(q.v1).first;
-        c2 = code_of_v(q.v2).first;
-        if (c2 < c1) std::swap(c1,c2);
+namespace detail {
+
+template <QuerySpec::Op op, Probe probe>
+struct RangeMasks {
+    static void apply(uint64_t lt1, uint64_t eq1, uint64_t gt1,
+                      uint64_t lt2, uint64_t eq2, uint64_t gt2,
+                      uint64_t& def, uint64_t& cand) {
+        using Op = QuerySpec::Op;
+        constexpr bool lo = probe == Probe::Lo || probe == Probe::Both;
+        constexpr bool hi = probe == Probe::Hi || probe == Probe::Both;
+        // An exact boundary code is wholly in or out; otherwise it is probed.
+        if constexpr (op == Op::LT) def = lt1;
+        else if constexpr (op == Op::LE) def = lo ? lt1 : ~gt1;
+        else if constexpr (op == Op::GT) def = gt1;
+        else if constexpr (op == Op::GE) def = lo ? gt1 : ~lt1;
+        else if constexpr (op == Op::EQ) def = lo ? 0 : eq1;
+        else if constexpr (op == Op::NE) def = ~eq1;
+        else def = (lo ? gt1 : ~lt1) & (hi ? lt2 : ~gt2); // BETWEEN
+        cand = (lo ? eq1 : 0) | (hi ? eq2 : 0);
+        (void)lt2; (void)gt2;
     }
+};
 
-    if (q.op == QuerySpec::Op::LT) {
-        // value < v1: definite matches have code < c1; boundary bucket c1 needs base probe
-        const uint32_t c1_local = c1;
-        const uint64_t v1_local = q.v1;
-
-        // Simple unrolled loop (4-at-a-time) to help auto-vectorization
-        size_t i = 0;
-        size_t limit = N & ~size_t(3); // round down to multiple of 4
-        for (; i < limit; i += 4) {
-            uint8_t c0 = codes[i];
-            uint8_t c1c = codes[i+1];
-            uint8_t c2c = codes[i+2];
-            uint8_t c3c = codes[i+3];
-
-            if (c0 < c1_local || (c0 == c1_local && base[i] < v1_local))     out.set(i);
-            if (c1c < c1_local || (c1c == c1_local && base[i+1] < v1_local)) out.set(i+1);
-            if (c2c < c1_local || (c2c == c1_local && base[i+2] < v1_local)) out.set(i+2);
-            if (c3c < c1_local || (c3c == c1_local && base[i+3] < v1_local)) out.set(i+3);
-        }
-        for (; i < N; ++i) {
-            uint8_t c = codes[i];
-            if (c < c1_local) out.set(i);
-            else if (c == c1_local && base[i] < v1_local) out.set(i);
+template <QuerySpec::Op op>
+inline bool key_matches(uint64_t k, const RangeArgs& a) {
+    using Op = QuerySpec::Op;
+    if constexpr (op == Op::LT) return k < a.v1;
+    else if constexpr (op == Op::LE) return k <= a.v1;
+    else if constexpr (op == Op::GT) return k > a.v1;
+    else if constexpr (op == Op::GE) return k >= a.v1;
+    else if constexpr (op == Op::EQ) return k == a.v1;
+    else if constexpr (op == Op::NE) return k != a.v1;
+    else return k >= a.v1 && k <= a.v2;
+}
+
+template <QuerySpec::Op op, Probe probe, class Base>
+inline uint64_t probe_word(uint64_t def, uint64_t cand, const Base& base, size_t row0,
+                           const RangeArgs& a) {
+    if constexpr (probe != Probe::None) {
+        while (cand) {
+            const size_t j = static_cast<size_t>(__builtin_ctzll(cand));
+            if (key_matches<op>(base[row0 + j], a)) def |= 1ULL << j;
+            cand &= cand - 1;
         }
-        return out;
+    } else {
+        (void)cand; (void)base; (void)row0; (void)a;
     }
+    return def;
+}
 
-    if (q.op == QuerySpec::Op::EQ) {
-        const uint32_t c1_local = c1;
-        const uint64_t v1_local = q.v1;
-        bool is_unique = std::binary_search(L.art.uniques.begin(), L.art.uniques.end(), v1_local);
-
-        size_t i = 0;
-        size_t limit = N & ~size_t(3);
-        if (is_unique) {
-            // All matches are exactly code == c1; no base probes needed
-            for (; i < limit; i += 4) {
-                uint8_t c0 = codes[i];
-                uint8_t c1c = codes[i+1];
-                uint8_t c2c = codes[i+2];
-                uint8_t c3c = codes[i+3];
-                if (c0 == c1_local) out.set(i);
-                if (c1c == c1_local) out.set(i+1);
-                if (c2c == c1_local) out.set(i+2);
-                if (c3c == c1_local) out.set(i+3);
-            }
-            for (; i < N; ++i) {
-                if (codes[i] == c1_local) out.set(i);
-            }
-        } else {
-            // Only boundary bucket c1 can contain v1; need base equality check
-            for (; i < limit; i += 4) {
-                uint8_t c0 = codes[i];
-                uint8_t c1c = codes[i+1];
-                uint8_t c2c = codes[i+2];
-                uint8_t c3c = codes[i+3];
-
-                if (c0 == c1_local && base[i]   == v1_local) out.set(i);
-                if (c1c == c1_local && base[i+1] == v1_local) out.set(i+1);
-                if (c2c == c1_local && base[i+2] == v1_local) out.set(i+2);
-                if (c3c == c1_local && base[i+3] == v1_local) out.set(i+3);
-            }
-            for (; i < N; ++i) {
-                if (codes[i] == c1_local && base[i] == v1_local) out.set(i);
-            }
+template <class IsaT, class Code, QuerySpec::Op op, Probe probe, class Base>
+void range_scan(const void* codes, const Base& base, size_t N, const RangeArgs& a, uint64_t* W) {
+    using Masks = RangeMasks<op, probe>;
+    const Code* C = static_cast<const Code*>(codes);
+    constexpr size_t kBatch = 64; // words per batch: 4096 rows, masks stay in L1
+    uint64_t def[kBatch], cand[kBatch];
+    const size_t full = N >> 6;
+    for (size_t w0 = 0; w0 < full; w0 += kBatch) {
+        const size_t n = std::min(kBatch, full - w0);
+        IsaT::template words<Code, Masks>(C + (w0 << 6), n, a.c1, a.c2, def, cand);
+        for (size_t w = 0; w < n; ++w) {
+            const uint64_t live = a.dead ? ~a.dead[w0 + w] : ~0ULL;
+            W[w0 + w] = probe_word<op, probe>(def[w] & live, cand[w] & live, base, (w0 + w) << 6, a);
         }
-        return out;
     }
+    if (const size_t rest = N & 63) {
+        Code tail[64] = {};
+        std::copy(C + (full << 6), C + N, tail);
+        ScalarIsa::words<Code, Masks>(tail, 1, a.c1, a.c2, def, cand);
+        const uint64_t valid = ((1ULL << rest) - 1) & (a.dead ? ~a.dead[full] : ~0ULL);
+        W[full] = probe_word<op, probe>(def[0] & valid, cand[0] & valid, base, full << 6, a);
+    }
+}
 
-    // BETWEEN inclusive [v1, v2]
-    {
-        const uint32_t c1_local = c1;
-        const uint32_t c2_local = c2;
-        const uint64_t low  = q.v1;
-        const uint64_t high = q.v2;
-
-        size_t i = 0;
-        size_t limit = N & ~size_t(3);
-
-        for (; i < limit; i += 4) {
-            uint8_t c0 = codes[i];
-            uint8_t c1c = codes[i+1];
-            uint8_t c2c = codes[i+2];
-            uint8_t c3c = codes[i+3];
-
-            // c in (c1,c2)
-            if (c0 > c1_local && c0 < c2_local) out.set(i);
-            else if (c0 == c1_local && base[i]   >= low && base[i]   <= high) out.set(i);
-            else if (c0 == c2_local && base[i]   >= low && base[i]   <= high) out.set(i);
-
-            if (c1c > c1_local && c1c < c2_local) out.set(i+1);
-            else if (c1c == c1_local && base[i+1] >= low && base[i+1] <= high) out.set(i+1);
-            else if (c1c == c2_local && base[i+1] >= low && base[i+1] <= high) out.set(i+1);
-
-            if (c2c > c1_local && c2c < c2_local) out.set(i+2);
-            else if (c2c == c1_local && base[i+2] >= low && base[i+2] <= high) out.set(i+2);
-            else if (c2c == c2_local && base[i+2] >= low && base[i+2] <= high) out.set(i+2);
-
-            if (c3c > c1_local && c3c < c2_local) out.set(i+3);
-            else if (c3c == c1_local && base[i+3] >= low && base[i+3] <= high) out.set(i+3);
-            else if (c3c == c2_local && base[i+3] >= low && base[i+3] <= high) out.set(i+3);
-        }
+} // namespace detail
+
+template <class Base>
+using RangeKernel = void (*)(const void* codes, const Base& base, size_t N,
+                             const RangeArgs& a, uint64_t* W);
+
+// Variant order within a table row: six single-constant ops x {None, Lo},
+// then BETWEEN x {None, Lo, Hi, Both}.
+constexpr size_t kRangeVariants = 16;
+
+inline size_t range_variant(QuerySpec::Op op, Probe probe) {
+    using Op = QuerySpec::Op;
+    const size_t p = static_cast<size_t>(probe);
+    switch (op) {
+    case Op::LT: return 0 + p;
+    case Op::LE: return 2 + p;
+    case Op::GT: return 4 + p;
+    case Op::GE: return 6 + p;
+    case Op::EQ: return 8 + p;
+    case Op::NE: return 10 + p;
+    case Op::BETWEEN: return 12 + p;
+    case Op::IN: break;
+    }
+    throw std::invalid_argument("range_variant: IN has no range kernel");
+}
 
-        for (; i < N; ++i) {
-            uint8_t c = codes[i];
-            if (c > c1_local && c < c2_local) {
-                out.set(i);
-            } else if (c == c1_local || c == c2_local) {
-                if (base[i] >= low && base[i] <= high) out.set(i);
-            } else if (c1_local == c2_local && c == c1_local) {
-                if (base[i] >= low && base[i] <= high) out.set(i);
-            }
+namespace detail {
+
+template <class Base, class IsaT, class Code>
+using RangeRow = std::array<RangeKernel<Base>, kRangeVariants>;
+
+template <class Base, class IsaT, class Code>
+constexpr RangeRow<Base, IsaT, Code> range_row() {
+    using Op = QuerySpec::Op;
+    return {{
+        &range_scan<IsaT, Code, Op::LT, Probe::None, Base>, &range_scan<IsaT, Code, Op::LT, Probe::Lo, Base>,
+        &range_scan<IsaT, Code, Op::LE, Probe::None, Base>, &range_scan<IsaT, Code, Op::LE, Probe::Lo, Base>,
+        &range_scan<IsaT, Code, Op::GT, Probe::None, Base>, &range_scan<IsaT, Code, Op::GT, Probe::Lo, Base>,
+        &range_scan<IsaT, Code, Op::GE, Probe::None, Base>, &range_scan<IsaT, Code, Op::GE, Probe::Lo, Base>,
+        &range_scan<IsaT, Code, Op::EQ, Probe::None, Base>, &range_scan<IsaT, Code, Op::EQ, Probe::Lo, Base>,
+        &range_scan<IsaT, Code, Op::NE, Probe::None, Base>, &range_scan<IsaT, Code, Op::NE, Probe::Lo, Base>,
+        &range_scan<IsaT, Code, Op::BETWEEN, Probe::None, Base>, &range_scan<IsaT, Code, Op::BETWEEN, Probe::Lo, Base>,
+        &range_scan<IsaT, Code, Op::BETWEEN, Probe::Hi, Base>, &range_scan<IsaT, Code, Op::BETWEEN, Probe::Both, Base>,
+    }};
+}
+
+} // namespace detail
+
+// Select the kernel for (ISA, code width, op, probe mode).
+template <class Base>
+RangeKernel<Base> range_kernel(Isa isa, bool codes16, QuerySpec::Op op, Probe probe) {
+    using Table = std::array<std::array<std::array<RangeKernel<Base>, kRangeVariants>, 2>, 4>;
+    static const Table table = {{
+        {{detail::range_row<Base, ScalarIsa, uint8_t>(), detail::range_row<Base, ScalarIsa, uint16_t>()}},
+        {{detail::range_row<Base, Sse42Isa, uint8_t>(), detail::range_row<Base, Sse42Isa, uint16_t>()}},
+        {{detail::range_row<Base, Avx2Isa, uint8_t>(), detail::range_row<Base, Avx2Isa, uint16_t>()}},
+        {{detail::range_row<Base, Avx512Isa, uint8_t>(), detail::range_row<Base, Avx512Isa, uint16_t>()}},
+    }};
+    return table[static_cast<size_t>(isa)][codes16 ? 1 : 0][range_variant(op, probe)];
+}
+
+// A map without range endpoints encodes only its uniques, and then every
+// stored key is one of them; code_of() throws for any other constant.
+// Rewrites such constants onto the nearest stored value that selects the
+// same rows: LT/LE x -> LT next, GT/GE x -> GE next (next: the smallest
+// unique above x), BETWEEN bounds move inwards, absent IN members are
+// dropped and absent NE matches every row. Returns false when no row can
+// match (absent EQ, empty BETWEEN, nothing left of an IN). Queries on maps
+// with ranges are left as they are.
+inline bool encodable_query(const MapArtifacts& art, QuerySpec& q) {
+    using Op = QuerySpec::Op;
+    const auto& U = art.uniques;
+    if (!art.endpoints.empty() || U.empty()) return true;
+    auto stored = [&](uint64_t v) { return std::binary_search(U.begin(), U.end(), v); };
+    switch (q.op) {
+    case Op::IN:
+        q.values.erase(std::remove_if(q.values.begin(), q.values.end(),
+                                      [&](uint64_t v) { return !stored(v); }),
+                       q.values.end());
+        return !q.values.empty();
+    case Op::BETWEEN: {
+        if (q.v2 < q.v1) return false;
+        const auto lo = std::lower_bound(U.begin(), U.end(), q.v1);
+        const auto hi = std::upper_bound(U.begin(), U.end(), q.v2);
+        if (lo >= hi) return false;
+        q.v1 = *lo;
+        q.v2 = *(hi - 1);
+        return true;
+    }
+    default:
+        break;
+    }
+    if (stored(q.v1)) return true;
+    const auto next = std::lower_bound(U.begin(), U.end(), q.v1);
+    switch (q.op) {
+    case Op::EQ:
+        return false;
+    case Op::NE:
+        q.op = Op::LE;
+        q.v1 = U.back();
+        return true;
+    case Op::LT:
+    case Op::LE:
+        if (next == U.end()) {
+            q.op = Op::LE;
+            q.v1 = U.back();
+        } else {
+            q.op = Op::LT;
+            q.v1 = *next;
         }
-        return out;
+        return true;
+    default: // GT, GE
+        if (next == U.end()) return false;
+        q.op = Op::GE;
+        q.v1 = *next;
+        return true;
+    }
+}
+
+// Translate a (non-IN) predicate into kernel arguments and probe mode.
+// Constants must be encodable (see encodable_query).
+inline Probe range_args(const MapArtifacts& art, const QuerySpec& q, RangeArgs& a) {
+    a.v1 = q.v1;
+    a.v2 = q.v2;
+    a.c1 = NumericCompressionMap::code_of(art, q.v1).first;
+    const bool lo = !NumericCompressionMap::is_exact(art, q.v1);
+    if (q.op != QuerySpec::Op::BETWEEN) {
+        a.c2 = a.c1;
+        return lo ? Probe::Lo : Probe::None;
     }
+    a.c2 = NumericCompressionMap::code_of(art, q.v2).first;
+    const bool hi = !NumericCompressionMap::is_exact(art, q.v2);
+    return lo && hi ? Probe::Both : lo ? Probe::Lo : hi ? Probe::Hi : Probe::None;
 }
 
 // ---------------------------------------------------------------------
-//  Generic scalar fallback (16-bit codes or non-optimized path)
+//  Table-driven scan: every code is classified once per query as reject,
+//  definite or candidate (probe the base). Used for IN, where any set of
+//  codes costs one pass regardless of how many constants the list holds.
 // ---------------------------------------------------------------------
 
-inline BitVector scan_predicate_scalar(const LoadedMap& L,
-                                       const void* codes, bool codes16,
-                                       const std::vector<uint64_t>& base,
-                                       const QuerySpec& q) {
-    const size_t N = base.size();
-    BitVector out(N);
-
-    auto code_of_v = [&](uint64_t v){ return NumericCompressionMap::code_of(L.art, v); };
-
-    uint32_t c1=0, c2=0;
-    if (q.op == QuerySpec::Op::LT || q.op == QuerySpec::Op::EQ) {
-        c1 = code_of_v(q.v1).first;
-    } else {
-        c1 = code_of_v(q.v1).first;
-        c2 = code_of_v(q.v2).first;
-        if (c2 < c1) std::swap(c1,c2);
-    }
+enum CodeClass : uint8_t { kReject = 0, kDefinite = 1, kCandidate = 2 };
 
-    auto code_at = [&](size_t i)->uint32_t {
-        if (!codes16) return static_cast<const uint8_t*>(codes)[i];
-        return static_cast<const uint16_t*>(codes)[i];
+inline std::vector<uint8_t> classify_codes(const MapArtifacts& art, const QuerySpec& q) {
+    const uint32_t total = art.total_codes;
+    std::vector<uint8_t> cls(total, kReject);
+    auto code = [&](uint64_t v) { return NumericCompressionMap::code_of(art, v).first; };
+    auto exact = [&](uint64_t v) { return NumericCompressionMap::is_exact(art, v); };
+    auto fill = [&](uint32_t a, uint32_t b) { // [a, b)
+        for (uint32_t c = a; c < b && c < total; ++c) cls[c] = kDefinite;
     };
 
-    if (q.op == QuerySpec::Op::LT) {
-        for (size_t i=0;i<N;++i) {
-            uint32_t c = code_at(i);
-            if (c < c1) out.set(i);
-            else if (c == c1 && base[i] < q.v1) out.set(i);
+    using Op = QuerySpec::Op;
+    switch (q.op) {
+    case Op::LT:
+    case Op::LE: {
+        const uint32_t c = code(q.v1);
+        fill(0, c);
+        cls[c] = exact(q.v1) ? (q.op == Op::LE ? kDefinite : kReject) : kCandidate;
+        break;
+    }
+    case Op::GT:
+    case Op::GE: {
+        const uint32_t c = code(q.v1);
+        fill(c + 1, total);
+        cls[c] = exact(q.v1) ? (q.op == Op::GE ? kDefinite : kReject) : kCandidate;
+        break;
+    }
+    case Op::EQ:
+    case Op::NE: {
+        const uint32_t c = code(q.v1);
+        if (q.op == Op::NE) fill(0, total);
+        cls[c] = exact(q.v1) ? (q.op == Op::EQ ? kDefinite : kReject) : kCandidate;
+        break;
+    }
+    case Op::BETWEEN: {
+        const uint32_t c1 = code(q.v1), c2 = code(q.v2);
+        fill(c1 + 1, c2);
+        cls[c1] = kCandidate;
+        cls[c2] = kCandidate;
+        break;
+    }
+    case Op::IN:
+        for (uint64_t v : q.values) {
+            const uint32_t c = code(v);
+            if (exact(v)) cls[c] = kDefinite;
+            else if (cls[c] != kDefinite) cls[c] = kCandidate;
         }
-        return out;
+        break;
     }
+    return cls;
+}
 
-    if (q.op == QuerySpec::Op::EQ) {
-        bool is_unique = std::binary_search(L.art.uniques.begin(), L.art.uniques.end(), q.v1);
-        if (is_unique) {
-            for (size_t i=0;i<N;++i) if (code_at(i)==c1) out.set(i);
-            return out;
-        }
-        for (size_t i=0;i<N;++i) {
-            if (code_at(i)==c1 && base[i]==q.v1) out.set(i);
+namespace detail {
+
+// Per 64 rows: bit masks of definite and candidate rows.
+inline void classify_words_scalar(const uint8_t* cls, const void* codes, bool codes16,
+                                  size_t w_begin, size_t w_end, size_t N,
+                                  uint64_t* def, uint64_t* cand) {
+    for (size_t w = w_begin; w < w_end; ++w) {
+        uint64_t d = 0, c = 0;
+        const size_t i0 = w << 6;
+        const size_t n = std::min<size_t>(64, N - i0);
+        for (size_t j = 0; j < n; ++j) {
+            const uint32_t code = codes16 ? static_cast<const uint16_t*>(codes)[i0 + j]
+                                          : static_cast<const uint8_t*>(codes)[i0 + j];
+            d |= static_cast<uint64_t>(cls[code] == kDefinite) << j;
+            c |= static_cast<uint64_t>(cls[code] == kCandidate) << j;
         }
-        return out;
+        def[w - w_begin] = d;
+        cand[w - w_begin] = c;
+    }
+}
+
+#if defined(CSKETCH_X86_DISPATCH)
+// 256-bit code sets tested with pshufb: the low nibble picks a byte holding
+// the set bits of the 8 codes sharing it (one table per high-nibble half),
+// and the high nibble picks the bit within that byte.
+struct NibbleSet {
+    alignas(16) uint8_t lo[16]; // codes 0x00..0x7F
+    alignas(16) uint8_t hi[16]; // codes 0x80..0xFF
+};
+
+inline NibbleSet nibble_set(const uint8_t* cls, size_t total, uint8_t want) {
+    NibbleSet s{};
+    for (size_t c = 0; c < total && c < 256; ++c) {
+        if (cls[c] != want) continue;
+        const size_t hn = c >> 4, ln = c & 15;
+        (hn < 8 ? s.lo : s.hi)[ln] |= static_cast<uint8_t>(1u << (hn & 7));
     }
+    return s;
+}
+
+__attribute__((target("avx2"))) inline uint32_t
+nibble_test_avx2(__m256i lo_nib, __m256i bit, __m256i sel_hi, const NibbleSet& s) {
+    const __m256i tl = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(s.lo)));
+    const __m256i th = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(s.hi)));
+    const __m256i row = _mm256_blendv_epi8(_mm256_shuffle_epi8(tl, lo_nib),
+                                           _mm256_shuffle_epi8(th, lo_nib), sel_hi);
+    const __m256i hit = _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit);
+    return static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+}
 
-    // BETWEEN
-    for (size_t i=0;i<N;++i) {
-        uint32_t c = code_at(i);
-        if (c>c1 && c<c2) {
-            out.set(i);
-        } else if (c==c1 || c==c2) {
-            if (base[i] >= q.v1 && base[i] <= q.v2) out.set(i);
-        } else if (c1==c2 && c==c1) {
-            if (base[i] >= q.v1 && base[i] <= q.v2) out.set(i);
+__attribute__((target("avx2"))) inline void
+classify_words_avx2(const NibbleSet& ds, const NibbleSet& cs, const uint8_t* codes,
+                    size_t w_begin, size_t w_end, uint64_t* def, uint64_t* cand) {
+    const __m256i nib = _mm256_set1_epi8(0x0F);
+    const __m256i seven = _mm256_set1_epi8(7);
+    const __m256i bitpos = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                            1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    for (size_t w = w_begin; w < w_end; ++w) {
+        uint64_t d = 0, c = 0;
+        for (int half = 0; half < 2; ++half) {
+            const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + (w << 6) + 32 * half));
+            const __m256i lo_nib = _mm256_and_si256(x, nib);
+            const __m256i hi_nib = _mm256_and_si256(_mm256_srli_epi16(x, 4), nib);
+            const __m256i bit = _mm256_shuffle_epi8(bitpos, hi_nib);
+            const __m256i sel_hi = _mm256_cmpgt_epi8(hi_nib, seven);
+            d |= static_cast<uint64_t>(nibble_test_avx2(lo_nib, bit, sel_hi, ds)) << (32 * half);
+            c |= static_cast<uint64_t>(nibble_test_avx2(lo_nib, bit, sel_hi, cs)) << (32 * half);
+        }
+        def[w - w_begin] = d;
+        cand[w - w_begin] = c;
+    }
+}
+#endif
+
+// Scan codes[0, N) against a classification table into mask words W. Rows
+// set in `dead` (tombstone words, optional) never match and are not probed.
+template <class Base>
+void classified_scan(const std::vector<uint8_t>& cls, const void* codes, bool codes16,
+                     const Base& base, size_t N, const QuerySpec& q, uint64_t* W,
+                     const uint64_t* dead = nullptr) {
+    const size_t words = (N + 63) >> 6;
+    constexpr size_t kBatch = 64; // words classified per batch
+    uint64_t def[kBatch], cand[kBatch];
+
+#if defined(CSKETCH_X86_DISPATCH)
+    const bool simd = !codes16 && active_isa() >= Isa::Avx2;
+    detail::NibbleSet ds{}, cs{};
+    if (simd) {
+        ds = detail::nibble_set(cls.data(), cls.size(), kDefinite);
+        cs = detail::nibble_set(cls.data(), cls.size(), kCandidate);
+    }
+#endif
+    for (size_t w0 = 0; w0 < words; w0 += kBatch) {
+        const size_t w1 = std::min(words, w0 + kBatch);
+        // Full words go through SIMD; the ragged last word stays scalar.
+        const size_t full_end = std::min(w1, N >> 6);
+        size_t w = w0;
+#if defined(CSKETCH_X86_DISPATCH)
+        if (simd && full_end > w0) {
+            detail::classify_words_avx2(ds, cs, static_cast<const uint8_t*>(codes), w0, full_end,
+                                        def, cand);
+            w = full_end;
+        }
+#endif
+        if (w < w1) {
+            detail::classify_words_scalar(cls.data(), codes, codes16, w, w1, N,
+                                          def + (w - w0), cand + (w - w0));
+        }
+        for (w = w0; w < w1; ++w) {
+            const uint64_t live = dead ? ~dead[w] : ~0ULL;
+            uint64_t hits = def[w - w0] & live;
+            uint64_t probe = cand[w - w0] & live;
+            while (probe) {
+                const size_t j = static_cast<size_t>(__builtin_ctzll(probe));
+                if (q.matches(base[(w << 6) + j])) hits |= 1ULL << j;
+                probe &= probe - 1;
+            }
+            W[w] = hits;
         }
     }
+}
+
+} // namespace detail
+
+template <class Base>
+BitVector scan_classified(const LoadedMap& L, const void* codes, bool codes16,
+                          const Base& base, size_t N, const QuerySpec& q,
+                          const BitVector* deleted = nullptr) {
+    BitVector out(N);
+    QuerySpec eq = q;
+    if (!encodable_query(L.art, eq)) return out;
+    detail::classified_scan(classify_codes(L.art, eq), codes, codes16, base, N, eq, out.words().data(),
+                            deleted ? deleted->words().data() : nullptr);
     return out;
 }
 
 // ---------------------------------------------------------------------
-//  Public entry point used by run_query / benchmark
+//  Public entry point used by run_query / benchmark. Rows set in the
+//  optional `deleted` bitmap are masked out inside the kernels.
 // ---------------------------------------------------------------------
 
+template <class Base>
+BitVector scan_predicate(const LoadedMap& L,
+                         const void* codes, bool codes16,
+                         const Base& base, size_t N,
+                         const QuerySpec& q, const BitVector* deleted = nullptr) {
+    if (deleted && deleted->size() != N) {
+        throw std::invalid_argument("scan_predicate: tombstone bitmap length differs from column");
+    }
+    if (q.op == QuerySpec::Op::IN) {
+        return scan_classified(L, codes, codes16, base, N, q, deleted);
+    }
+    BitVector out(N);
+    QuerySpec eq = q;
+    if (!encodable_query(L.art, eq)) return out;
+    RangeArgs a;
+    const Probe probe = range_args(L.art, eq, a);
+    a.dead = deleted ? deleted->words().data() : nullptr;
+    range_kernel<Base>(active_isa(), codes16, eq.op, probe)(codes, base, N, a, out.words().data());
+    return out;
+}
+
+template <class Alloc>
+BitVector scan_predicate(const LoadedMap& L,
+                         const void* codes, bool codes16,
+                         const std::vector<uint64_t, Alloc>& base,
+                         const QuerySpec& q, const BitVector* deleted = nullptr) {
+    return scan_predicate(L, codes, codes16, base.data(), base.size(), q, deleted);
+}
+
 inline BitVector scan_predicate(const LoadedMap& L,
                                 const void* codes, bool codes16,
-                                const std::vector<uint64_t>& base,
-                                const QuerySpec& q) {
-    // Fast path: 8-bit codes with specialized loop
-    if (!codes16 && L.code_bits == 8) {
-        const uint8_t* c8 = static_cast<const uint8_t*>(codes);
-        return scan_predicate_8bit(L, c8, base, q);
-    }
-    // Fallback: generic scalar implementation (works for 8-bit and 16-bit)
-    return scan_predicate_scalar(L, codes, codes16, base, q);
+                                const PackedColumn& base,
+                                const QuerySpec& q, const BitVector* deleted = nullptr) {
+    return scan_predicate(L, codes, codes16, base, base.size(), q, deleted);
 }
 
 } // namespace csketch
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#ifndef CSKETCH_X86_DISPATCH
+#define CSKETCH_X86_DISPATCH 1
+#endif
+#endif
+
+namespace csketch {
+
+// ---------------------------------------------------------------------
+//  ISA levels for the code-comparison kernels. Each level provides
+//  words<Code, Combine>(): for every 64 codes it compares against two
+//  constants (c1, c2) and hands the six masks (code <, ==, > each) to
+//  Combine::apply, which the compiler inlines into the ISA-targeted loop
+//  and prunes down to the compares the query actually uses.
+// ---------------------------------------------------------------------
+
+enum class Isa { Scalar = 0, Sse42 = 1, Avx2 = 2, Avx512 = 3 };
+
+inline Isa best_isa() {
+#if defined(CSKETCH_X86_DISPATCH)
+  static const Isa isa = __builtin_cpu_supports("avx512bw") ? Isa::Avx512
+                         : __builtin_cpu_supports("avx2")   ? Isa::Avx2
+                         : __builtin_cpu_supports("sse4.2") ? Isa::Sse42
+                                                            : Isa::Scalar;
+  return isa;
+#else
+  return Isa::Scalar;
+#endif
+}
+
+// Requested level (default: best available); kernels never go above best_isa().
+inline Isa &isa_policy() {
+  static Isa isa = best_isa();
+  return isa;
+}
+
+inline Isa active_isa() { return isa_policy() < best_isa() ? isa_policy() : best_isa(); }
+
+inline Isa parse_isa(const std::string &s) {
+  if (s == "auto") return best_isa();
+  if (s == "scalar") return Isa::Scalar;
+  if (s == "sse4.2") return Isa::Sse42;
+  if (s == "avx2") return Isa::Avx2;
+  if (s == "avx512") return Isa::Avx512;
+  throw std::runtime_error("unknown ISA level: " + s);
+}
+
+inline const char *isa_name(Isa isa) {
+  switch (isa) {
+  case Isa::Scalar: return "scalar";
+  case Isa::Sse42: return "sse4.2";
+  case Isa::Avx2: return "avx2";
+  case Isa::Avx512: return "avx512";
+  }
+  return "?";
+}
+
+struct ScalarIsa {
+  template <class Code, class Combine>
+  static void words(const Code *codes, size_t nwords, uint32_t c1, uint32_t c2, uint64_t *def,
+                    uint64_t *cand) {
+    for (size_t w = 0; w < nwords; ++w) {
+      const Code *p = codes + (w << 6);
+      uint64_t lt1 = 0, eq1 = 0, gt1 = 0, lt2 = 0, eq2 = 0, gt2 = 0;
+      for (unsigned j = 0; j < 64; ++j) {
+        const uint32_t c = p[j];
+        lt1 |= static_cast<uint64_t>(c < c1) << j;
+        eq1 |= static_cast<uint64_t>(c == c1) << j;
+        gt1 |= static_cast<uint64_t>(c > c1) << j;
+        lt2 |= static_cast<uint64_t>(c < c2) << j;
+        eq2 |= static_cast<uint64_t>(c == c2) << j;
+        gt2 |= static_cast<uint64_t>(c > c2) << j;
+      }
+      Combine::apply(lt1, eq1, gt1, lt2, eq2, gt2, def[w], cand[w]);
+    }
+  }
+};
+
+#if defined(CSKETCH_X86_DISPATCH)
+
+namespace detail {
+
+// Unsigned lane compares via signed ones on sign-flipped inputs.
+struct Cmp64 {
+  uint64_t lt = 0, eq = 0, gt = 0;
+};
+
+__attribute__((target("sse4.2"))) inline Cmp64 cmp64_sse(const uint8_t *p, uint32_t c) {
+  const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+  const __m128i k = _mm_set1_epi8(static_cast<char>(c ^ 0x80));
+  Cmp64 r;
+  for (unsigned i = 0; i < 4; ++i) {
+    const __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i)), bias);
+    const unsigned sh = 16 * i;
+    r.lt |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(k, x)))) << sh;
+    r.eq |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(k, x)))) << sh;
+    r.gt |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(x, k)))) << sh;
+  }
+  return r;
+}
+
+// 16-bit lane masks a, b (8 rows each) -> 16 row bits.
+__attribute__((target("sse4.2"))) inline uint64_t bits16_sse(__m128i a, __m128i b) {
+  return static_cast<uint16_t>(_mm_movemask_epi8(_mm_packs_epi16(a, b)));
+}
+
+__attribute__((target("sse4.2"))) inline Cmp64 cmp64_sse(const uint16_t *p, uint32_t c) {
+  const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+  const __m128i k = _mm_set1_epi16(static_cast<short>(c ^ 0x8000));
+  Cmp64 r;
+  for (unsigned i = 0; i < 4; ++i) {
+    const __m128i a = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i)), bias);
+    const __m128i b = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i + 8)), bias);
+    const unsigned sh = 16 * i;
+    r.lt |= bits16_sse(_mm_cmpgt_epi16(k, a), _mm_cmpgt_epi16(k, b)) << sh;
+    r.eq |= bits16_sse(_mm_cmpeq_epi16(k, a), _mm_cmpeq_epi16(k, b)) << sh;
+    r.gt |= bits16_sse(_mm_cmpgt_epi16(a, k), _mm_cmpgt_epi16(b, k)) << sh;
+  }
+  return r;
+}
+
+__attribute__((target("avx2"))) inline Cmp64 cmp64_avx2(const uint8_t *p, uint32_t c) {
+  const __m256i bias = _mm256_set1_epi8(static_cast<char>(0x80));
+  const __m256i k = _mm256_set1_epi8(static_cast<char>(c ^ 0x80));
+  Cmp64 r;
+  for (unsigned i = 0; i < 2; ++i) {
+    const __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32 * i)), bias);
+    const unsigned sh = 32 * i;
+    r.lt |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(k, x)))) << sh;
+    r.eq |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(k, x)))) << sh;
+    r.gt |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(x, k)))) << sh;
+  }
+  return r;
+}
+
+// 16-bit lane masks a, b (16 rows each) -> 32 row bits. packs works per
+// 128-bit lane; the permute restores row order.
+__attribute__((target("avx2"))) inline uint64_t bits16_avx2(__m256i a, __m256i b) {
+  const __m256i m = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8);
+  return static_cast<uint32_t>(_mm256_movemask_epi8(m));
+}
+
+__attribute__((target("avx2"))) inline Cmp64 cmp64_avx2(const uint16_t *p, uint32_t c) {
+  const __m256i bias = _mm256_set1_epi16(static_cast<short>(0x8000));
+  const __m256i k = _mm256_set1_epi16(static_cast<short>(c ^ 0x8000));
+  Cmp64 r;
+  for (unsigned i = 0; i < 2; ++i) {
+    const __m256i a = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32 * i)), bias);
+    const __m256i b = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32 * i + 16)), bias);
+    const unsigned sh = 32 * i;
+    r.lt |= bits16_avx2(_mm256_cmpgt_epi16(k, a), _mm256_cmpgt_epi16(k, b)) << sh;
+    r.eq |= bits16_avx2(_mm256_cmpeq_epi16(k, a), _mm256_cmpeq_epi16(k, b)) << sh;
+    r.gt |= bits16_avx2(_mm256_cmpgt_epi16(a, k), _mm256_cmpgt_epi16(b, k)) << sh;
+  }
+  return r;
+}
+
+__attribute__((target("avx512bw"))) inline Cmp64 cmp64_avx512(const uint8_t *p, uint32_t c) {
+  const __m512i k = _mm512_set1_epi8(static_cast<char>(c));
+  const __m512i x = _mm512_loadu_si512(p);
+  return {_mm512_cmplt_epu8_mask(x, k), _mm512_cmpeq_epu8_mask(x, k), _mm512_cmpgt_epu8_mask(x, k)};
+}
+
+inline uint64_t join32(uint32_t lo, uint32_t hi) { return static_cast<uint64_t>(lo) | static_cast<uint64_t>(hi) << 32; }
+
+__attribute__((target("avx512bw"))) inline Cmp64 cmp64_avx512(const uint16_t *p, uint32_t c) {
+  const __m512i k = _mm512_set1_epi16(static_cast<short>(c));
+  const __m512i a = _mm512_loadu_si512(p);
+  const __m512i b = _mm512_loadu_si512(p + 32);
+  return {join32(_mm512_cmplt_epu16_mask(a, k), _mm512_cmplt_epu16_mask(b, k)),
+          join32(_mm512_cmpeq_epu16_mask(a, k), _mm512_cmpeq_epu16_mask(b, k)),
+          join32(_mm512_cmpgt_epu16_mask(a, k), _mm512_cmpgt_epu16_mask(b, k))};
+}
+
+} // namespace detail
+
+struct Sse42Isa {
+  template <class Code, class Combine>
+  __attribute__((target("sse4.2"))) static void words(const Code *codes, size_t nwords, uint32_t c1,
+                                                      uint32_t c2, uint64_t *def, uint64_t *cand) {
+    for (size_t w = 0; w < nwords; ++w) {
+      const detail::Cmp64 a = detail::cmp64_sse(codes + (w << 6), c1);
+      const detail::Cmp64 b = detail::cmp64_sse(codes + (w << 6), c2);
+      Combine::apply(a.lt, a.eq, a.gt, b.lt, b.eq, b.gt, def[w], cand[w]);
+    }
+  }
+};
+
+struct Avx2Isa {
+  template <class Code, class Combine>
+  __attribute__((target("avx2"))) static void words(const Code *codes, size_t nwords, uint32_t c1,
+                                                    uint32_t c2, uint64_t *def, uint64_t *cand) {
+    for (size_t w = 0; w < nwords; ++w) {
+      const detail::Cmp64 a = detail::cmp64_avx2(codes + (w << 6), c1);
+      const detail::Cmp64 b = detail::cmp64_avx2(codes + (w << 6), c2);
+      Combine::apply(a.lt, a.eq, a.gt, b.lt, b.eq, b.gt, def[w], cand[w]);
+    }
+  }
+};
+
+struct Avx512Isa {
+  template <class Code, class Combine>
+  __attribute__((target("avx512bw"))) static void words(const Code *codes, size_t nwords, uint32_t c1,
+                                                        uint32_t c2, uint64_t *def, uint64_t *cand) {
+    for (size_t w = 0; w < nwords; ++w) {
+      const detail::Cmp64 a = detail::cmp64_avx512(codes + (w << 6), c1);
+      const detail::Cmp64 b = detail::cmp64_avx512(codes + (w << 6), c2);
+      Combine::apply(a.lt, a.eq, a.gt, b.lt, b.eq, b.gt, def[w], cand[w]);
+    }
+  }
+};
+
+#else
+
+using Sse42Isa = ScalarIsa;
+using Avx2Isa = ScalarIsa;
+using Avx512Isa = ScalarIsa;
+
+#endif
+
+} // namespace csketch
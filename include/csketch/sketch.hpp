@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "csketch/column.hpp"
+#include "csketch/compression_map.hpp"
+#include "csketch/memory.hpp"
+#include "csketch/parallel.hpp"
+
+namespace csketch {
+
+// Code array for one column plus the per-code row counts seen while encoding.
+struct EncodedSketch {
+  uint32_t code_bits = 8;         // 8 or 16
+  ColumnVector<uint8_t> codes8;   // code_bits == 8
+  ColumnVector<uint16_t> codes16; // code_bits == 16
+  std::vector<uint64_t> code_rows;
+  size_t boundary_hits = 0;
+
+  size_t size() const { return code_bits == 8 ? codes8.size() : codes16.size(); }
+  const void *data() const {
+    return code_bits == 8 ? static_cast<const void *>(codes8.data())
+                          : static_cast<const void *>(codes16.data());
+  }
+  size_t bytes() const { return size() * (code_bits / 8); }
+};
+
+inline uint32_t code_bits_for(uint32_t total_codes) {
+  if (total_codes == 0) {
+    throw std::runtime_error("map produced zero codes");
+  }
+  if (total_codes > 65536) {
+    throw std::runtime_error("total codes exceed 16-bit storage limit");
+  }
+  return (total_codes <= 256) ? 8u : 16u;
+}
+
+// Encode keys with code_of(), splitting the rows over `threads` workers by
+// worker_range() so each writes the code pages it first-touched.
+// code_bits == 0 picks the narrowest width that fits the map.
+inline EncodedSketch encode_sketch(const MapArtifacts &art, const uint64_t *keys, size_t N,
+                                   unsigned threads = 1, uint32_t code_bits = 0) {
+  EncodedSketch sk;
+  sk.code_bits = code_bits ? code_bits : code_bits_for(art.total_codes);
+  if (sk.code_bits < code_bits_for(art.total_codes)) {
+    throw std::runtime_error("encode_sketch: code_bits too narrow for map");
+  }
+  if (sk.code_bits == 8) {
+    resize_uninitialized(sk.codes8, N);
+  } else {
+    resize_uninitialized(sk.codes16, N);
+  }
+
+  if (threads == 0) {
+    threads = default_threads();
+  }
+  const size_t tasks = std::max<size_t>(1, std::min<size_t>(threads, N / 65536 + 1));
+  std::vector<std::vector<uint64_t>> rows(tasks);
+  std::vector<size_t> hits(tasks, 0);
+  parallel_for_local(static_cast<unsigned>(tasks), [&](unsigned t) {
+    const auto [begin, end] = worker_range(N, static_cast<unsigned>(tasks), t);
+    rows[t].assign(art.total_codes, 0);
+    for (size_t i = begin; i < end; ++i) {
+      auto [code, boundary] = NumericCompressionMap::code_of(art, keys[i]);
+      if (sk.code_bits == 8) {
+        sk.codes8[i] = static_cast<uint8_t>(code);
+      } else {
+        sk.codes16[i] = static_cast<uint16_t>(code);
+      }
+      hits[t] += boundary;
+      ++rows[t][code];
+    }
+  });
+
+  sk.code_rows.assign(art.total_codes, 0);
+  for (size_t t = 0; t < tasks; ++t) {
+    sk.boundary_hits += hits[t];
+    for (size_t c = 0; c < art.total_codes; ++c) {
+      sk.code_rows[c] += rows[t][c];
+    }
+  }
+  return sk;
+}
+
+template <class Alloc>
+EncodedSketch encode_sketch(const MapArtifacts &art, const std::vector<uint64_t, Alloc> &keys,
+                            unsigned threads = 1, uint32_t code_bits = 0) {
+  return encode_sketch(art, keys.data(), keys.size(), threads, code_bits);
+}
+
+// Per-code rows, min/max key and value sum of an encoded column, saved with
+// the map for approximate answers and estimates that never read the base.
+inline CodeStats code_stats(const EncodedSketch &sk, const uint64_t *keys, size_t N, DType dtype,
+                            unsigned threads = 1) {
+  if (N != sk.size()) {
+    throw std::invalid_argument("code_stats: codes and keys lengths differ");
+  }
+  const size_t total = sk.code_rows.size();
+  if (threads == 0) {
+    threads = default_threads();
+  }
+  const size_t tasks = std::max<size_t>(1, std::min<size_t>(threads, N / 65536 + 1));
+  std::vector<CodeStats> part(tasks);
+  parallel_for(tasks, static_cast<unsigned>(tasks), [&](size_t t) {
+    CodeStats &s = part[t];
+    s.min_key.assign(total, std::numeric_limits<uint64_t>::max());
+    s.max_key.assign(total, 0);
+    s.sum.assign(total, 0.0);
+    const auto [begin, end] = worker_range(N, static_cast<unsigned>(tasks), static_cast<unsigned>(t));
+    for (size_t i = begin; i < end; ++i) {
+      const size_t c = sk.code_bits == 8 ? sk.codes8[i] : sk.codes16[i];
+      s.min_key[c] = std::min(s.min_key[c], keys[i]);
+      s.max_key[c] = std::max(s.max_key[c], keys[i]);
+      s.sum[c] += key_value(keys[i], dtype);
+    }
+  });
+
+  CodeStats out = std::move(part[0]);
+  out.rows = sk.code_rows;
+  for (size_t t = 1; t < tasks; ++t) {
+    for (size_t c = 0; c < total; ++c) {
+      out.min_key[c] = std::min(out.min_key[c], part[t].min_key[c]);
+      out.max_key[c] = std::max(out.max_key[c], part[t].max_key[c]);
+      out.sum[c] += part[t].sum[c];
+    }
+  }
+  return out;
+}
+
+template <class Alloc>
+CodeStats code_stats(const EncodedSketch &sk, const std::vector<uint64_t, Alloc> &keys, DType dtype,
+                     unsigned threads = 1) {
+  return code_stats(sk, keys.data(), keys.size(), dtype, threads);
+}
+
+inline void save_sketch(const EncodedSketch &sk, const std::string &path) {
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    throw std::runtime_error("save_sketch: cannot open output sketch");
+  }
+  out.write(static_cast<const char *>(sk.data()), static_cast<std::streamsize>(sk.bytes()));
+}
+
+} // namespace csketch
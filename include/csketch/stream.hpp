@@ -0,0 +1,411 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(CSKETCH_HAVE_URING)
+#include <liburing.h>
+#endif
+
+#include "csketch/bitvector.hpp"
+#include "csketch/column.hpp"
+#include "csketch/container.hpp"
+#include "csketch/memory.hpp"
+#include "csketch/scan.hpp"
+
+namespace csketch {
+
+// ---------------------------------------------------------------------
+//  Streaming scans: the sketch and base are read in fixed-size row chunks
+//  into a ring of buffers while earlier chunks are scanned, so a cold query
+//  costs roughly max(I/O, compute) rather than their sum. Reads go through
+//  io_uring when built with liburing, otherwise through a reader thread
+//  issuing pread().
+// ---------------------------------------------------------------------
+
+// One file region read chunk by chunk: elem_bytes per row from `offset`.
+struct StreamSource {
+  std::string path;
+  uint64_t offset = 0;
+  uint32_t elem_bytes = 1;
+};
+
+struct StreamChunk {
+  uint64_t row_begin = 0;
+  size_t rows = 0;
+  std::vector<ColumnVector<uint8_t>> data; // one buffer per source
+};
+
+// Ring of `depth` chunk buffers filled ahead of the consumer. next() hands
+// out chunks in row order and blocks until the next one has landed;
+// release() returns it to the ring.
+class ChunkPipeline {
+public:
+  ChunkPipeline(std::vector<StreamSource> sources, uint64_t rows, size_t chunk_rows,
+                unsigned depth)
+      : sources_(std::move(sources)), rows_(rows), chunk_rows_(chunk_rows),
+        depth_(depth ? depth : 1) {
+    if (chunk_rows_ == 0) {
+      throw std::invalid_argument("ChunkPipeline: chunk_rows must be > 0");
+    }
+    chunks_ = static_cast<size_t>((rows_ + chunk_rows_ - 1) / chunk_rows_);
+    for (const auto &s : sources_) {
+      int fd = ::open(s.path.c_str(), O_RDONLY);
+      if (fd < 0) {
+        close_all();
+        throw std::runtime_error("ChunkPipeline: cannot open " + s.path);
+      }
+      ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+      fds_.push_back(fd);
+    }
+    slots_.resize(depth_);
+    for (auto &slot : slots_) {
+      slot.chunk.data.resize(sources_.size());
+      for (size_t s = 0; s < sources_.size(); ++s) {
+        slot.chunk.data[s].resize(chunk_rows_ * sources_[s].elem_bytes);
+      }
+    }
+#if defined(CSKETCH_HAVE_URING)
+    if (::io_uring_queue_init(depth_ * static_cast<unsigned>(sources_.size()), &ring_, 0) == 0) {
+      uring_ = true;
+      for (size_t k = 0; k < std::min<size_t>(depth_, chunks_); ++k) {
+        submit_uring(k);
+      }
+      return;
+    }
+#endif
+    reader_ = std::thread([this] { reader_loop(); });
+  }
+
+  ChunkPipeline(const ChunkPipeline &) = delete;
+  ChunkPipeline &operator=(const ChunkPipeline &) = delete;
+
+  ~ChunkPipeline() {
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    if (reader_.joinable()) {
+      reader_.join();
+    }
+#if defined(CSKETCH_HAVE_URING)
+    if (uring_) {
+      try {
+        while (inflight_ > 0) {
+          reap_uring();
+        }
+      } catch (...) {
+      }
+      ::io_uring_queue_exit(&ring_);
+    }
+#endif
+    close_all();
+  }
+
+  size_t chunks() const { return chunks_; }
+
+  // nullptr once every chunk has been handed out.
+  const StreamChunk *next() {
+    if (consumed_ == chunks_) {
+      return nullptr;
+    }
+    Slot &slot = slots_[consumed_ % depth_];
+#if defined(CSKETCH_HAVE_URING)
+    if (uring_) {
+      while (slot.pending > 0) {
+        reap_uring();
+      }
+      if (slot.failed) {
+        throw std::runtime_error("ChunkPipeline: read failed");
+      }
+      ++consumed_;
+      return &slot.chunk;
+    }
+#endif
+    std::unique_lock<std::mutex> lock(mu_);
+    cv_.wait(lock, [&] { return slot.ready || error_; });
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    ++consumed_;
+    return &slot.chunk;
+  }
+
+  void release(const StreamChunk *chunk) {
+    const size_t k = static_cast<size_t>(chunk->row_begin / chunk_rows_);
+#if defined(CSKETCH_HAVE_URING)
+    if (uring_) {
+      if (k + depth_ < chunks_) {
+        submit_uring(k + depth_);
+      }
+      return;
+    }
+#endif
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      slots_[k % depth_].ready = false;
+    }
+    cv_.notify_all();
+  }
+
+private:
+  struct Slot {
+    StreamChunk chunk;
+    bool ready = false; // reader thread: filled and not yet released
+    size_t pending = 0; // io_uring: reads still in flight
+    bool failed = false;
+  };
+
+  void close_all() {
+    for (int fd : fds_) {
+      ::close(fd);
+    }
+    fds_.clear();
+  }
+
+  void prepare(Slot &slot, size_t k) {
+    slot.chunk.row_begin = k * chunk_rows_;
+    slot.chunk.rows = static_cast<size_t>(std::min<uint64_t>(chunk_rows_, rows_ - slot.chunk.row_begin));
+  }
+
+  void read_full(size_t s, uint8_t *dst, size_t bytes, uint64_t at) {
+    while (bytes > 0) {
+      const ssize_t got = ::pread(fds_[s], dst, bytes, static_cast<off_t>(at));
+      if (got <= 0) {
+        throw std::runtime_error("ChunkPipeline: short read from " + sources_[s].path);
+      }
+      dst += got;
+      at += static_cast<uint64_t>(got);
+      bytes -= static_cast<size_t>(got);
+    }
+  }
+
+  void reader_loop() {
+    try {
+      for (size_t k = 0; k < chunks_; ++k) {
+        Slot &slot = slots_[k % depth_];
+        {
+          std::unique_lock<std::mutex> lock(mu_);
+          cv_.wait(lock, [&] { return !slot.ready || stop_; });
+          if (stop_) {
+            return;
+          }
+        }
+        prepare(slot, k);
+        for (size_t s = 0; s < sources_.size(); ++s) {
+          const uint64_t eb = sources_[s].elem_bytes;
+          read_full(s, slot.chunk.data[s].data(), slot.chunk.rows * eb,
+                    sources_[s].offset + slot.chunk.row_begin * eb);
+        }
+        {
+          std::lock_guard<std::mutex> lock(mu_);
+          slot.ready = true;
+        }
+        cv_.notify_all();
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mu_);
+      error_ = std::current_exception();
+      cv_.notify_all();
+    }
+  }
+
+#if defined(CSKETCH_HAVE_URING)
+  // A short read marks the chunk failed: regular files only return short
+  // reads at EOF, and sources are sized against `rows` up front.
+  void submit_uring(size_t k) {
+    const size_t si = k % depth_;
+    Slot &slot = slots_[si];
+    prepare(slot, k);
+    slot.failed = false;
+    slot.pending = sources_.size();
+    for (size_t s = 0; s < sources_.size(); ++s) {
+      const uint64_t eb = sources_[s].elem_bytes;
+      io_uring_sqe *sqe = ::io_uring_get_sqe(&ring_);
+      ::io_uring_prep_read(sqe, fds_[s], slot.chunk.data[s].data(),
+                           static_cast<unsigned>(slot.chunk.rows * eb),
+                           sources_[s].offset + slot.chunk.row_begin * eb);
+      sqe->user_data = (static_cast<uint64_t>(si) << 16) | s;
+    }
+    inflight_ += sources_.size();
+    ::io_uring_submit(&ring_);
+  }
+
+  void reap_uring() {
+    io_uring_cqe *cqe = nullptr;
+    if (::io_uring_wait_cqe(&ring_, &cqe) != 0) {
+      throw std::runtime_error("ChunkPipeline: io_uring wait failed");
+    }
+    Slot &slot = slots_[cqe->user_data >> 16];
+    const size_t s = cqe->user_data & 0xFFFF;
+    if (cqe->res < 0 || static_cast<uint64_t>(cqe->res) != slot.chunk.rows * sources_[s].elem_bytes) {
+      slot.failed = true;
+    }
+    --slot.pending;
+    --inflight_;
+    ::io_uring_cqe_seen(&ring_, cqe);
+  }
+
+  io_uring ring_{};
+  bool uring_ = false;
+  size_t inflight_ = 0;
+#endif
+
+  std::vector<StreamSource> sources_;
+  uint64_t rows_;
+  size_t chunk_rows_;
+  unsigned depth_;
+  size_t chunks_ = 0;
+  size_t consumed_ = 0;
+  std::vector<int> fds_;
+  std::vector<Slot> slots_;
+
+  std::thread reader_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::exception_ptr error_;
+};
+
+inline uint32_t dtype_bytes(DType t) {
+  switch (t) {
+  case DType::U32:
+  case DType::I32:
+  case DType::F32:
+  case DType::STR:
+    return 4;
+  default:
+    return 8;
+  }
+}
+
+struct StreamOptions {
+  size_t chunk_rows = size_t(1) << 20; // rounded up to a multiple of 64
+  unsigned depth = 4;                  // buffers in the ring
+};
+
+// Where a streamed column lives. Loose files hold the raw dtype; container
+// sections already hold u64 keys (base_is_keys).
+struct StreamInput {
+  StreamSource codes;
+  StreamSource base;
+  DType dtype = DType::U64;
+  bool base_is_keys = false;
+  uint64_t rows = 0;
+};
+
+inline uint64_t file_bytes(const std::string &path) {
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0) {
+    throw std::runtime_error("cannot stat " + path);
+  }
+  return static_cast<uint64_t>(st.st_size);
+}
+
+// Stream input for a loose .sketch + raw base file pair.
+inline StreamInput stream_files(const std::string &sketch_path, const std::string &base_path,
+                                DType dtype, uint32_t code_bits) {
+  StreamInput in;
+  in.dtype = dtype;
+  in.codes = {sketch_path, 0, code_bits / 8};
+  in.base = {base_path, 0, dtype_bytes(dtype)};
+  const uint64_t base_bytes = file_bytes(base_path);
+  if (base_bytes % in.base.elem_bytes != 0) {
+    throw std::runtime_error("stream_files: base size not a multiple of the dtype");
+  }
+  in.rows = base_bytes / in.base.elem_bytes;
+  if (file_bytes(sketch_path) != in.rows * in.codes.elem_bytes) {
+    throw std::runtime_error("sketch length does not match base length");
+  }
+  return in;
+}
+
+// Stream input for the base and codes sections of a .csk container.
+inline StreamInput stream_container(const std::string &path, const ContainerView &view) {
+  StreamInput in;
+  in.dtype = view.dtype();
+  in.base_is_keys = true;
+  in.rows = view.rows();
+  in.codes = {path, view.section_offset(SectionKind::Codes), view.code_bits() / 8};
+  in.base = {path, view.section_offset(SectionKind::Base), 8};
+  return in;
+}
+
+namespace detail {
+
+template <class T>
+void keys_from_raw(const uint8_t *raw, size_t n, uint64_t *keys) {
+  for (size_t i = 0; i < n; ++i) {
+    T v;
+    std::memcpy(&v, raw + i * sizeof(T), sizeof(T));
+    keys[i] = to_key<T>(v);
+  }
+}
+
+inline const uint64_t *chunk_keys(const StreamInput &in, const uint8_t *raw, size_t n,
+                                  ColumnVector<uint64_t> &scratch) {
+  if (in.base_is_keys || in.dtype == DType::U64) {
+    return reinterpret_cast<const uint64_t *>(raw);
+  }
+  uint64_t *keys = scratch.data();
+  switch (in.dtype) {
+  case DType::U32:
+  case DType::STR:
+    keys_from_raw<uint32_t>(raw, n, keys);
+    break;
+  case DType::I32:
+    keys_from_raw<int32_t>(raw, n, keys);
+    break;
+  case DType::I64:
+    keys_from_raw<int64_t>(raw, n, keys);
+    break;
+  case DType::F32:
+    keys_from_raw<float>(raw, n, keys);
+    break;
+  case DType::F64:
+    keys_from_raw<double>(raw, n, keys);
+    break;
+  case DType::U64:
+    break;
+  }
+  return keys;
+}
+
+} // namespace detail
+
+// Scan a column straight from disk through a ChunkPipeline. Each chunk is
+// converted to keys (if needed) and scanned while later chunks are read.
+inline BitVector scan_stream(const LoadedMap &L, const StreamInput &in, const QuerySpec &q,
+                             StreamOptions opt = {}) {
+  opt.chunk_rows = (std::max<size_t>(opt.chunk_rows, 1) + 63) & ~size_t(63);
+  BitVector out(in.rows);
+  uint64_t *W = out.words().data();
+  const bool codes16 = (L.code_bits == 16);
+  ColumnVector<uint64_t> scratch;
+  resize_uninitialized(scratch, opt.chunk_rows);
+
+  ChunkPipeline pipe({in.codes, in.base}, in.rows, opt.chunk_rows, opt.depth);
+  while (const StreamChunk *c = pipe.next()) {
+    const uint64_t *keys = detail::chunk_keys(in, c->data[1].data(), c->rows, scratch);
+    BitVector local = scan_predicate(L, c->data[0].data(), codes16, keys, c->rows, q);
+    std::memcpy(W + (c->row_begin >> 6), local.words().data(),
+                local.words().size() * sizeof(uint64_t));
+    pipe.release(c);
+  }
+  return out;
+}
+
+} // namespace csketch
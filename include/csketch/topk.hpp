@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "csketch/aggregate.hpp"
+#include "csketch/memory.hpp"
+#include "csketch/parallel.hpp"
+#include "csketch/scan.hpp"
+#include "csketch/simd.hpp"
+
+namespace csketch {
+
+// ---------------------------------------------------------------------
+//  Top-K (ORDER BY ... LIMIT K) without sorting the base column. Codes
+//  preserve order, so a walk over the code histogram finds the threshold
+//  code t holding the K-th row: every row with a code before t is in the
+//  answer, rows after t are not. One code pass collects both sets, and only
+//  rows of t are probed to pick the remainder. Ties on the key go to the
+//  lower row id.
+// ---------------------------------------------------------------------
+
+struct TopK {
+  std::vector<uint64_t> rows; // in output order
+  std::vector<uint64_t> keys; // keys[i] is the key of rows[i]
+  uint32_t threshold = 0;     // code holding the K-th row
+  uint64_t probed = 0;        // threshold-bucket rows read from the base
+};
+
+namespace detail {
+
+// Row ids with code before t (in) and equal to t (at) over mask words
+// [w_begin, w_end); `largest` reverses the order. The RangeMasks of LT/GT
+// with a probed constant give exactly these two masks.
+template <class IsaT, class Code, bool largest>
+void topk_collect(const void *codes, size_t N, size_t w_begin, size_t w_end, uint32_t t,
+                  std::vector<uint64_t> &in, std::vector<uint64_t> &at) {
+  using Masks = RangeMasks<largest ? QuerySpec::Op::GT : QuerySpec::Op::LT, Probe::Lo>;
+  const Code *C = static_cast<const Code *>(codes);
+  constexpr size_t kBatch = 64;
+  uint64_t def[kBatch], cand[kBatch];
+  auto emit = [&](uint64_t bits, size_t row0, std::vector<uint64_t> &out) {
+    while (bits) {
+      out.push_back(row0 + static_cast<size_t>(__builtin_ctzll(bits)));
+      bits &= bits - 1;
+    }
+  };
+  const size_t full = std::min(w_end, N >> 6);
+  for (size_t w0 = w_begin; w0 < full; w0 += kBatch) {
+    const size_t n = std::min(kBatch, full - w0);
+    IsaT::template words<Code, Masks>(C + (w0 << 6), n, t, t, def, cand);
+    for (size_t w = 0; w < n; ++w) {
+      emit(def[w], (w0 + w) << 6, in);
+      emit(cand[w], (w0 + w) << 6, at);
+    }
+  }
+  const size_t rest = N & 63;
+  if (rest && w_end > full) {
+    Code tail[64] = {};
+    std::copy(C + (full << 6), C + N, tail);
+    ScalarIsa::words<Code, Masks>(tail, 1, t, t, def, cand);
+    const uint64_t valid = (1ULL << rest) - 1;
+    emit(def[0] & valid, full << 6, in);
+    emit(cand[0] & valid, full << 6, at);
+  }
+}
+
+using TopKCollect = void (*)(const void *, size_t, size_t, size_t, uint32_t, std::vector<uint64_t> &,
+                             std::vector<uint64_t> &);
+
+inline TopKCollect topk_kernel(Isa isa, bool codes16, bool largest) {
+  using Row = std::array<TopKCollect, 4>; // {u8, u16} x {smallest, largest}
+  static const std::array<Row, 4> table = {{
+      {{&topk_collect<ScalarIsa, uint8_t, false>, &topk_collect<ScalarIsa, uint8_t, true>,
+        &topk_collect<ScalarIsa, uint16_t, false>, &topk_collect<ScalarIsa, uint16_t, true>}},
+      {{&topk_collect<Sse42Isa, uint8_t, false>, &topk_collect<Sse42Isa, uint8_t, true>,
+        &topk_collect<Sse42Isa, uint16_t, false>, &topk_collect<Sse42Isa, uint16_t, true>}},
+      {{&topk_collect<Avx2Isa, uint8_t, false>, &topk_collect<Avx2Isa, uint8_t, true>,
+        &topk_collect<Avx2Isa, uint16_t, false>, &topk_collect<Avx2Isa, uint16_t, true>}},
+      {{&topk_collect<Avx512Isa, uint8_t, false>, &topk_collect<Avx512Isa, uint8_t, true>,
+        &topk_collect<Avx512Isa, uint16_t, false>, &topk_collect<Avx512Isa, uint16_t, true>}},
+  }};
+  return table[static_cast<size_t>(isa)][(codes16 ? 2 : 0) + (largest ? 1 : 0)];
+}
+
+} // namespace detail
+
+// The K smallest (or largest) keys of codes/base[0, N), ordered. `hist` is
+// the rows-per-code histogram of the same rows; pass L.stats.rows for a full
+// column to skip the histogram pass.
+template <class Base>
+TopK top_k(const LoadedMap &L, const void *codes, bool codes16, const Base &base, size_t N, size_t k,
+           bool largest = false, unsigned threads = 1, const std::vector<uint64_t> *hist = nullptr) {
+  TopK r;
+  k = std::min(k, N);
+  if (k == 0) {
+    return r;
+  }
+  if (threads == 0) {
+    threads = default_threads();
+  }
+  std::vector<uint64_t> own;
+  if (!hist) {
+    own = code_histogram(codes, codes16, N, L.art.total_codes, threads);
+    hist = &own;
+  }
+  const size_t T = hist->size();
+  if (T == 0) {
+    throw std::invalid_argument("top_k: empty code histogram");
+  }
+
+  // Walk codes from the wanted end until the K-th row is reached.
+  uint64_t before = 0;
+  size_t step = 0;
+  for (; step < T; ++step) {
+    const size_t c = largest ? T - 1 - step : step;
+    if (before + (*hist)[c] >= k) {
+      break;
+    }
+    before += (*hist)[c];
+  }
+  if (step == T) {
+    throw std::invalid_argument("top_k: histogram holds fewer rows than the column");
+  }
+  r.threshold = static_cast<uint32_t>(largest ? T - 1 - step : step);
+
+  const size_t words = (N + 63) >> 6;
+  const size_t tasks = std::max<size_t>(1, std::min<size_t>(threads, N / 65536 + 1));
+  std::vector<std::vector<uint64_t>> in(tasks), at(tasks);
+  const detail::TopKCollect collect = detail::topk_kernel(active_isa(), codes16, largest);
+  parallel_for(tasks, static_cast<unsigned>(tasks), [&](size_t t) {
+    const auto [w_begin, w_end] = worker_range(words, static_cast<unsigned>(tasks), static_cast<unsigned>(t));
+    collect(codes, N, w_begin, w_end, r.threshold, in[t], at[t]);
+  });
+
+  // Keys of rows before the threshold (all kept) and of the threshold
+  // bucket (a code whose stats show one key needs no probe).
+  using Entry = std::pair<uint64_t, uint64_t>; // key, row
+  std::vector<Entry> top, bucket;
+  top.reserve(k);
+  for (const auto &part : in) {
+    for (uint64_t row : part) {
+      top.emplace_back(base[row], row);
+    }
+  }
+  const CodeStats &st = L.stats;
+  const bool one_key = !st.empty() && st.min_key[r.threshold] == st.max_key[r.threshold];
+  for (const auto &part : at) {
+    for (uint64_t row : part) {
+      bucket.emplace_back(one_key ? st.min_key[r.threshold] : base[row], row);
+    }
+  }
+  r.probed = one_key ? 0 : bucket.size();
+  if (top.size() != before) {
+    throw std::invalid_argument("top_k: histogram does not match the codes");
+  }
+
+  auto order = [largest](const Entry &a, const Entry &b) {
+    if (a.first != b.first) {
+      return largest ? a.first > b.first : a.first < b.first;
+    }
+    return a.second < b.second;
+  };
+  const size_t need = k - top.size();
+  if (need < bucket.size()) {
+    std::nth_element(bucket.begin(), bucket.begin() + static_cast<std::ptrdiff_t>(need), bucket.end(), order);
+    bucket.resize(need);
+  }
+  top.insert(top.end(), bucket.begin(), bucket.end());
+  std::sort(top.begin(), top.end(), order);
+
+  r.rows.reserve(top.size());
+  r.keys.reserve(top.size());
+  for (const Entry &e : top) {
+    r.keys.push_back(e.first);
+    r.rows.push_back(e.second);
+  }
+  return r;
+}
+
+} // namespace csketch
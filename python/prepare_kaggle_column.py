@@ -5,12 +5,23 @@ import numpy as np
 import json
 from pathlib import Path
 
+def write_strings(path, values):
+    # .strs layout: u64 count, u64 offsets[count+1], concatenated UTF-8 bytes
+    encoded = [v.encode("utf-8") for v in values]
+    offsets = np.zeros(len(encoded) + 1, dtype=np.uint64)
+    offsets[1:] = np.cumsum([len(b) for b in encoded], dtype=np.uint64)
+    with open(path, "wb") as f:
+        f.write(np.uint64(len(encoded)).tobytes())
+        f.write(offsets.tobytes())
+        f.write(b"".join(encoded))
+
 def main():
     p = argparse.ArgumentParser()
     p.add_argument("--csv", required=True, help="Input Kaggle CSV file")
     p.add_argument("--column", required=True, help="Categorical column name")
     p.add_argument("--out-bin", required=True, help="Output binary file (u32)")
     p.add_argument("--out-dict", required=True, help="Output JSON mapping")
+    p.add_argument("--out-strings", help="Also write the raw strings (.strs) for --dtype str")
     args = p.parse_args()
 
     df = pd.read_csv(args.csv)
@@ -28,6 +39,10 @@ def main():
     with open(args.out_dict, "w") as f:
         json.dump(mapping, f, indent=2)
 
+    if args.out_strings:
+        write_strings(args.out_strings, col.tolist())
+        print(f"wrote {len(col)} strings to {args.out_strings}")
+
     print(f"wrote {len(codes)} rows to {args.out_bin}")
     print(f"distinct categories: {len(uniques)} (mapping -> {args.out_dict})")
 
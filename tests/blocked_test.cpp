@@ -0,0 +1,36 @@
+// scan_blocked over PAX blocks of assorted sizes matches a brute-force
+// filter.
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "csketch/blocked.hpp"
+#include "test_util.hpp"
+
+using namespace csketch_test;
+
+namespace {
+
+void check_blocked(const Fixture &f, std::mt19937_64 &rng) {
+  const std::string path = temp_file("column.pax");
+  write_blocked(path, DType::U64, f.keys, f.sk, 64 * (1 + rng() % 40));
+  const BlockedView blocked(path);
+  for (int op = 0; op < 8; ++op) {
+    for (int i = 0; i < 8; ++i) {
+      const QuerySpec q = make_query(static_cast<Op>(op), f.keys, rng);
+      check(scan_blocked(f.map, blocked, q, 1 + rng() % 3).words() == brute(f.keys, q).words(),
+            f.tag + " blocked " + describe(q));
+    }
+  }
+  std::remove(path.c_str());
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 rng(42);
+  for_each_fixture(rng, [&](const Fixture &f) { check_blocked(f, rng); });
+  return finish("blocked_test");
+}
@@ -0,0 +1,75 @@
+// CodeRangeCache answers every operator like a brute-force filter, whether
+// its pieces are cached, rebuilt or evicted, and keeps within its budget.
+
+#include <cstdint>
+#include <random>
+#include <string>
+
+#include "csketch/code_cache.hpp"
+#include "test_util.hpp"
+
+using namespace csketch_test;
+
+namespace {
+
+void check_cache(const Fixture &f, std::mt19937_64 &rng) {
+  const size_t N = f.keys.size();
+  const size_t mask_bytes = (N + 63) / 64 * sizeof(uint64_t);
+  CodeRangeCache roomy;
+  CodeRangeCache tight(3 * mask_bytes); // evicts on most queries
+  for (int op = 0; op < 8; ++op) {
+    for (int i = 0; i < 16; ++i) {
+      const QuerySpec q = make_query(static_cast<Op>(op), f.keys, rng);
+      const BitVector want = brute(f.keys, q);
+      for (CodeRangeCache *cache : {&roomy, &tight}) {
+        // Twice: the second answer comes from cached pieces.
+        for (int pass = 0; pass < 2; ++pass) {
+          check(cache->scan(f.tag, f.map, f.codes(), f.codes16(), f.keys.data(), N, q).words() == want.words(),
+                f.tag + " " + describe(q) + (cache == &tight ? " tight" : " roomy") + " pass " +
+                    std::to_string(pass));
+        }
+      }
+    }
+  }
+  const CodeRangeCache::Stats s = tight.stats();
+  check(s.bytes <= 3 * mask_bytes, f.tag + " tight cache over budget: " + std::to_string(s.bytes) + " bytes");
+  check(s.bytes == s.entries * mask_bytes, f.tag + " cache entries are not one mask each");
+}
+
+// An exact constant owns its code, so the cache answers without reading a
+// single key: scanning a base of zeros must still give the true answer.
+void check_exact_unprobed(const Fixture &f) {
+  const size_t N = f.keys.size();
+  const ColumnVector<uint64_t> zeros(N);
+  CodeRangeCache cache;
+  for (uint64_t u : f.map.art.uniques) {
+    if (!NumericCompressionMap::is_exact(f.map.art, u)) {
+      continue;
+    }
+    for (Op op : {Op::EQ, Op::NE, Op::LT, Op::LE, Op::GT, Op::GE}) {
+      QuerySpec q;
+      q.op = op;
+      q.v1 = u;
+      check(cache.scan(f.tag, f.map, f.codes(), f.codes16(), zeros.data(), N, q).words() ==
+                brute(f.keys, q).words(),
+            f.tag + " exact " + describe(q) + " probed the base");
+    }
+    QuerySpec in;
+    in.op = Op::IN;
+    in.values = {u};
+    check(cache.scan(f.tag, f.map, f.codes(), f.codes16(), zeros.data(), N, in).words() ==
+              brute(f.keys, in).words(),
+          f.tag + " exact " + describe(in) + " probed the base");
+  }
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 rng(36);
+  for_each_fixture(rng, [&](const Fixture &f) {
+    check_cache(f, rng);
+    check_exact_unprobed(f);
+  });
+  return finish("cache_test");
+}
@@ -0,0 +1,87 @@
+// String predicates translated through a StringDictionary and scanned over
+// the id sketch match a direct string compare, also for strings the column
+// does not hold.
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "csketch/dictionary.hpp"
+#include "test_util.hpp"
+
+using namespace csketch_test;
+
+namespace {
+
+// Short strings over a small alphabet, so prefixes are shared; '\xff'
+// exercises prefix_range's carry. Query strings run longer than column
+// strings, so most of them are absent.
+std::string random_string(size_t max_len, std::mt19937_64 &rng) {
+  static const char alphabet[] = {'a', 'b', 'c', '\xff'};
+  std::string s(rng() % (max_len + 1), 'a');
+  for (char &c : s) {
+    c = alphabet[rng() % 4];
+  }
+  return s;
+}
+
+// The reference; translate_string_predicate takes BETWEEN's bounds in
+// either order.
+bool matches(StringOp op, std::string_view s, std::string_view s1, std::string_view s2) {
+  switch (op) {
+  case StringOp::LT: return s < s1;
+  case StringOp::EQ: return s == s1;
+  case StringOp::BETWEEN: return std::min(s1, s2) <= s && s <= std::max(s1, s2);
+  case StringOp::PREFIX: return s.substr(0, s1.size()) == s1;
+  }
+  return false;
+}
+
+void check_dictionary(uint32_t max_codes, std::mt19937_64 &rng) {
+  StringColumn col;
+  for (size_t i = 0, n = 2000 + rng() % 5000; i < n; ++i) {
+    col.push_back(random_string(4, rng));
+  }
+  const StringDictionary dict = StringDictionary::build(col);
+  const std::vector<uint32_t> ids = dict.encode(col);
+  const ColumnVector<uint64_t> keys(ids.begin(), ids.end());
+  LoadedMap map;
+  map.art = NumericCompressionMap::build(keys, max_codes, 4096, 1);
+  map.dtype = "str";
+  check(max_codes < dict.size() || map.art.endpoints.empty(), "dictionary: map of every id has ranges");
+  const EncodedSketch sk = encode_sketch(map.art, keys, 1);
+  map.code_bits = sk.code_bits;
+
+  const std::string tag = "dictionary codes " + std::to_string(max_codes);
+  for (StringOp op : {StringOp::LT, StringOp::EQ, StringOp::BETWEEN, StringOp::PREFIX}) {
+    for (int i = 0; i < 40; ++i) {
+      const std::string s1 = i % 2 ? std::string(col[rng() % col.size()]) : random_string(6, rng);
+      const std::string s2 = random_string(6, rng);
+      const std::optional<QuerySpec> q = translate_string_predicate(dict, op, s1, s2);
+      const BitVector got = q ? scan_predicate(map, sk.data(), sk.code_bits == 16, keys, *q) : BitVector(col.size());
+      BitVector want(col.size());
+      for (size_t r = 0; r < col.size(); ++r) {
+        if (matches(op, col[r], s1, s2)) {
+          want.set(r);
+        }
+      }
+      static const char *names[] = {"lt", "eq", "between", "prefix"};
+      check(got.words() == want.words(), tag + " " + names[static_cast<int>(op)] + " \"" + s1 + "\" \"" + s2 +
+                                             "\"" + (q ? "" : " (no match)"));
+    }
+  }
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 rng(28);
+  for (uint32_t max_codes : {64u, 256u, 4096u}) {
+    check_dictionary(max_codes, rng);
+  }
+  return finish("dictionary_test");
+}
@@ -0,0 +1,37 @@
+// Every ISA level's range and classification kernels agree with a
+// brute-force filter, on 8- and 16-bit codes.
+
+#include <cstdint>
+#include <random>
+#include <string>
+
+#include "csketch/scan.hpp"
+#include "csketch/simd.hpp"
+#include "test_util.hpp"
+
+using namespace csketch_test;
+
+namespace {
+
+void check_kernels(const Fixture &f, std::mt19937_64 &rng) {
+  for (int op = 0; op < 8; ++op) {
+    for (int i = 0; i < 8; ++i) {
+      const QuerySpec q = make_query(static_cast<Op>(op), f.keys, rng);
+      const BitVector want = brute(f.keys, q);
+      for (int isa = 0; isa <= static_cast<int>(best_isa()); ++isa) {
+        isa_policy() = static_cast<Isa>(isa);
+        check(scan_predicate(f.map, f.codes(), f.codes16(), f.keys, q).words() == want.words(),
+              f.tag + " " + describe(q) + " isa=" + std::to_string(isa));
+      }
+    }
+  }
+  isa_policy() = best_isa();
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 rng(38);
+  for_each_fixture(rng, [&](const Fixture &f) { check_kernels(f, rng); });
+  return finish("kernels_test");
+}
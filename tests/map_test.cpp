@@ -0,0 +1,64 @@
+// NumericCompressionMap invariants: codes are order-preserving and
+// within the budget, and uniques own their codes.
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "csketch/compression_map.hpp"
+#include "test_util.hpp"
+
+using namespace csketch_test;
+
+namespace {
+
+// build() gives every unique its own code unless the unique sits in the run
+// of consecutive values ending at the top of the key space (those clamp
+// onto the last range, as in build_optimal).
+void check_map(const Fixture &f) {
+  const MapArtifacts &art = f.map.art;
+  std::vector<uint64_t> sorted(f.keys.begin(), f.keys.end());
+  std::sort(sorted.begin(), sorted.end());
+  uint32_t prev = 0;
+  for (uint64_t k : sorted) {
+    const uint32_t c = NumericCompressionMap::code_of(art, k).first;
+    check(c >= prev && c < art.total_codes, f.tag + ": code_of not order-preserving at " + std::to_string(k));
+    prev = c;
+  }
+  uint64_t top = std::numeric_limits<uint64_t>::max();
+  for (auto it = art.uniques.rbegin(); it != art.uniques.rend() && *it == top; ++it, --top) {
+  }
+  for (uint64_t u : art.uniques) {
+    if (u < top) {
+      check(NumericCompressionMap::is_exact(art, u), f.tag + ": unique " + std::to_string(u) + " is not exact");
+    }
+  }
+}
+
+// code_of regression: build() used to spend every code on ranges around the
+// uniques, so no heavy hitter owned its code (0 of 20 exact on this column).
+void check_heavy_hitters() {
+  std::mt19937_64 rng(11);
+  ColumnVector<uint64_t> keys(200000);
+  for (auto &k : keys) {
+    k = rng() % 2 ? 42 + 1000 * (rng() % 20) : rng() % 1000000;
+  }
+  const MapArtifacts art = NumericCompressionMap::build(keys, 256, 10000, 1000);
+  check(art.uniques.size() == 20, "heavy hitters: expected 20 uniques");
+  check(art.total_codes <= 256, "heavy hitters: code budget exceeded");
+  for (uint64_t u : art.uniques) {
+    check(NumericCompressionMap::is_exact(art, u), "heavy hitters: unique " + std::to_string(u) + " is not exact");
+  }
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 rng(2024);
+  check_heavy_hitters();
+  for_each_fixture(rng, check_map);
+  return finish("map_test");
+}
@@ -0,0 +1,92 @@
+// MutableSketch after random erases and updates: scan, scan_push and
+// scan_blocked with its tombstones match a brute-force filter over the live
+// rows, before and after compact().
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "csketch/blocked.hpp"
+#include "csketch/mutable_sketch.hpp"
+#include "test_util.hpp"
+
+using namespace csketch_test;
+
+namespace {
+
+// A map without ranges encodes only its uniques, so update() must reject
+// any other key and leave the row as it was.
+void update_row(MutableSketch &m, const Fixture &f, uint64_t row, uint64_t key) {
+  const MapArtifacts &art = f.map.art;
+  if (art.endpoints.empty() && !std::binary_search(art.uniques.begin(), art.uniques.end(), key)) {
+    const uint64_t before = m.keys()[row];
+    bool threw = false;
+    try {
+      m.update(row, key);
+    } catch (const std::invalid_argument &) {
+      threw = true;
+    }
+    check(threw && m.keys()[row] == before, f.tag + " update accepted unencodable " + std::to_string(key));
+    return;
+  }
+  m.update(row, key);
+}
+
+void check_mutable(const Fixture &f, std::mt19937_64 &rng) {
+  const size_t N = f.keys.size();
+  MutableSketch m(f.map, f.codes(), f.keys.data(), N);
+  for (size_t i = 0; i < N / 5; ++i) {
+    m.erase(rng() % N);
+  }
+  for (size_t i = 0; i < N / 10; ++i) {
+    const uint64_t row = rng() % N;
+    if (!m.tombstones().get(row)) {
+      update_row(m, f, row, pick_constant(f.keys, rng));
+    }
+  }
+
+  const std::string pax = temp_file("mutable.pax");
+  write_blocked(pax, DType::U64, m.keys(), m.sketch(), 64 * (1 + rng() % 40));
+  const BlockedView blocked(pax);
+
+  for (int op = 0; op < 8; ++op) {
+    for (int i = 0; i < 6; ++i) {
+      const QuerySpec q = make_query(static_cast<Op>(op), m.keys(), rng);
+      const BitVector want = brute(m.keys(), q, &m.tombstones());
+      const std::string what = f.tag + " mutable " + describe(q);
+      check(m.scan(q).words() == want.words(), what + " scan");
+      check(scan_blocked(m.map(), blocked, q, 2, &m.tombstones()).words() == want.words(), what + " blocked");
+
+      BitVector pushed(N);
+      PushOptions opt;
+      opt.morsel_rows = 64 * (1 + rng() % 100);
+      opt.threads = 2;
+      m.scan_push(
+          q,
+          [&](const MaskChunk &c) {
+            std::copy(c.words, c.words + (c.rows + 63) / 64, pushed.words().data() + (c.row >> 6));
+          },
+          opt);
+      check(pushed.words() == want.words(), what + " push");
+    }
+  }
+  std::remove(pax.c_str());
+
+  m.compact(2);
+  check(m.deleted_rows() == 0, f.tag + " compact left tombstones");
+  for (int op = 0; op < 8; ++op) {
+    const QuerySpec q = make_query(static_cast<Op>(op), m.keys(), rng);
+    check(m.scan(q).words() == brute(m.keys(), q).words(), f.tag + " compacted " + describe(q));
+  }
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 rng(45);
+  for_each_fixture(rng, [&](const Fixture &f) { check_mutable(f, rng); });
+  return finish("mutable_test");
+}
@@ -0,0 +1,44 @@
+// PackedColumn decodes every row it packed, also after a save/load round
+// trip, and scans over it match a brute-force filter.
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "csketch/packed_column.hpp"
+#include "csketch/scan.hpp"
+#include "test_util.hpp"
+
+using namespace csketch_test;
+
+namespace {
+
+void check_packed(const Fixture &f, std::mt19937_64 &rng) {
+  const std::string path = temp_file("column.packed");
+  PackedColumn::pack(f.keys).save(path);
+  const PackedColumn packed = PackedColumn::load(path);
+  std::remove(path.c_str());
+  check(packed.size() == f.keys.size(), f.tag + " packed: row count");
+  bool decoded = true;
+  for (size_t r = 0; r < f.keys.size(); ++r) {
+    decoded = decoded && packed[r] == f.keys[r];
+  }
+  check(decoded, f.tag + " packed: decoded keys differ");
+
+  for (int op = 0; op < 8; ++op) {
+    for (int i = 0; i < 6; ++i) {
+      const QuerySpec q = make_query(static_cast<Op>(op), f.keys, rng);
+      check(scan_predicate(f.map, f.codes(), f.codes16(), packed, q).words() == brute(f.keys, q).words(),
+            f.tag + " packed " + describe(q));
+    }
+  }
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 rng(35);
+  for_each_fixture(rng, [&](const Fixture &f) { check_packed(f, rng); });
+  return finish("packed_test");
+}
@@ -0,0 +1,85 @@
+// scan_partitioned against a brute-force filter, with constants that a
+// partition's map does not store.
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "csketch/partition.hpp"
+#include "test_util.hpp"
+
+using namespace csketch_test;
+
+namespace {
+
+BitVector scan(const std::pair<Manifest, EncodedSketch> &p, const ColumnVector<uint64_t> &keys, const QuerySpec &q) {
+  return scan_partitioned(p.first, p.second.data(), keys.data(), keys.size(), q, 2);
+}
+
+// Regression: a partition of few distinct values gets a map without ranges,
+// and a constant inside its [min, max] that it does not store made
+// scan_predicate throw "value not encodable".
+void check_range_less_partition() {
+  ColumnVector<uint64_t> keys(256);
+  for (size_t r = 0; r < keys.size(); ++r) {
+    keys[r] = r < 128 ? (r % 2 ? 5 : 1) : 1000 + r;
+  }
+  const auto p = build_partitioned(
+      keys, 128, 256, "u64",
+      [](const std::vector<uint64_t> &local) { return NumericCompressionMap::build(local, 256, 4096, 1); });
+  check(p.first.parts[0].map.art.endpoints.empty(), "range-less partition: map has ranges");
+  for (int op = 0; op < 8; ++op) {
+    QuerySpec q;
+    q.op = static_cast<Op>(op);
+    q.v1 = 3;
+    q.v2 = 4;
+    q.values = {2, 3, 4};
+    check(scan(p, keys, q).words() == brute(keys, q).words(), "range-less partition " + describe(q));
+  }
+}
+
+// Constants drawn from inside one partition's key range are mostly values
+// that partition does not store.
+void check_partitioned(int shape, std::mt19937_64 &rng) {
+  const ColumnVector<uint64_t> keys = make_column(shape, 3000 + rng() % 20000, rng);
+  const uint32_t max_codes = rng() % 2 ? 256 : 1024;
+  const auto p = build_partitioned(
+      keys, 64 * (1 + rng() % 100), max_codes, "u64",
+      [&](const std::vector<uint64_t> &local) { return NumericCompressionMap::build(local, max_codes, 4096, 8); },
+      2);
+  auto inside = [&]() {
+    const PartitionInfo &part = p.first.parts[rng() % p.first.parts.size()];
+    const uint64_t span = part.max_key - part.min_key;
+    return part.min_key + (span == std::numeric_limits<uint64_t>::max() ? rng() : rng() % (span + 1));
+  };
+  for (int op = 0; op < 8; ++op) {
+    for (int i = 0; i < 12; ++i) {
+      QuerySpec q = make_query(static_cast<Op>(op), keys, rng);
+      if (i % 2) {
+        q.v1 = inside();
+        q.v2 = q.v1 + rng() % 50;
+        for (uint64_t &v : q.values) {
+          v = inside();
+        }
+        std::sort(q.values.begin(), q.values.end());
+        q.values.erase(std::unique(q.values.begin(), q.values.end()), q.values.end());
+      }
+      check(scan(p, keys, q).words() == brute(keys, q).words(),
+            "shape " + std::to_string(shape) + " partitioned " + describe(q));
+    }
+  }
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 rng(31);
+  check_range_less_partition();
+  for (int shape = 0; shape < kShapes; ++shape) {
+    check_partitioned(shape, rng);
+  }
+  return finish("partition_test");
+}
@@ -0,0 +1,70 @@
+// scan_push hands every morsel to the consumer exactly once, and the masks
+// and row ids it delivers match a brute-force filter.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "csketch/push_scan.hpp"
+#include "test_util.hpp"
+
+using namespace csketch_test;
+
+namespace {
+
+void check_push(const Fixture &f, std::mt19937_64 &rng) {
+  const size_t N = f.keys.size();
+  for (int op = 0; op < 8; ++op) {
+    for (int i = 0; i < 8; ++i) {
+      const QuerySpec q = make_query(static_cast<Op>(op), f.keys, rng);
+      const BitVector want = brute(f.keys, q);
+      const std::string what = f.tag + " push " + describe(q);
+      PushOptions opt;
+      opt.morsel_rows = 64 * (1 + rng() % 100);
+      opt.threads = 1 + static_cast<unsigned>(rng() % 3);
+
+      // Morsels start on mask words, so concurrent consumers write disjoint words.
+      BitVector pushed(N);
+      std::atomic<size_t> rows{0};
+      scan_push(
+          f.map, f.codes(), f.codes16(), f.keys.data(), N, q,
+          [&](const MaskChunk &c) {
+            std::copy(c.words, c.words + (c.rows + 63) / 64, pushed.words().data() + (c.row >> 6));
+            rows += c.rows;
+          },
+          opt);
+      check(rows == N, what + " morsels cover " + std::to_string(rows.load()) + " rows");
+      check(pushed.words() == want.words(), what + " mask");
+
+      std::vector<std::vector<uint64_t>> per_worker(push_worker_count(N, opt));
+      scan_push_positions(
+          f.map, f.codes(), f.codes16(), f.keys.data(), N, q,
+          [&](const PositionChunk &c) {
+            per_worker[c.worker].insert(per_worker[c.worker].end(), c.positions, c.positions + c.count);
+          },
+          opt);
+      std::vector<uint64_t> got, expect;
+      for (const auto &p : per_worker) {
+        got.insert(got.end(), p.begin(), p.end());
+      }
+      std::sort(got.begin(), got.end());
+      for (size_t r = 0; r < N; ++r) {
+        if (want.get(r)) {
+          expect.push_back(r);
+        }
+      }
+      check(got == expect, what + " positions");
+    }
+  }
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 rng(44);
+  for_each_fixture(rng, [&](const Fixture &f) { check_push(f, rng); });
+  return finish("push_test");
+}
@@ -0,0 +1,51 @@
+// scan_stream from loose files and from a container against a brute-force
+// filter, with chunks that split the column at arbitrary word boundaries.
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "csketch/container.hpp"
+#include "csketch/stream.hpp"
+#include "test_util.hpp"
+
+using namespace csketch_test;
+
+namespace {
+
+void check_stream(const Fixture &f, std::mt19937_64 &rng) {
+  const std::string sketch_path = temp_file("stream.sketch");
+  const std::string base_path = temp_file("stream.bin");
+  const std::string csk_path = temp_file("stream.csk");
+  save_sketch(f.sk, sketch_path);
+  write_binary(base_path, f.keys);
+  write_container(csk_path, DType::U64, f.keys, f.map.art, f.sk, 64 * (1 + rng() % 100));
+  const ContainerView view(csk_path);
+  const StreamInput inputs[] = {stream_files(sketch_path, base_path, DType::U64, f.sk.code_bits),
+                                stream_container(csk_path, view)};
+
+  for (int op = 0; op < 8; ++op) {
+    for (int i = 0; i < 6; ++i) {
+      const QuerySpec q = make_query(static_cast<Op>(op), f.keys, rng);
+      const BitVector want = brute(f.keys, q);
+      for (const StreamInput &in : inputs) {
+        const StreamOptions opt{64 * (1 + rng() % 50), 1 + static_cast<unsigned>(rng() % 4)};
+        check(scan_stream(f.map, in, q, opt).words() == want.words(),
+              f.tag + " " + describe(q) + (in.base_is_keys ? " container" : " files") + " chunk " +
+                  std::to_string(opt.chunk_rows));
+      }
+    }
+  }
+  std::remove(sketch_path.c_str());
+  std::remove(base_path.c_str());
+  std::remove(csk_path.c_str());
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 rng(34);
+  for_each_fixture(rng, [&](const Fixture &f) { check_stream(f, rng); });
+  return finish("stream_test");
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+// Shared pieces of the brute-force tests: random columns, random
+// predicates, the reference answer and failure reporting.
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "csketch/bitvector.hpp"
+#include "csketch/compression_map.hpp"
+#include "csketch/memory.hpp"
+#include "csketch/scan.hpp"
+#include "csketch/sketch.hpp"
+
+namespace csketch_test {
+
+using namespace csketch;
+using Op = QuerySpec::Op;
+
+inline int &failures() {
+  static int n = 0;
+  return n;
+}
+
+inline void check(bool ok, const std::string &what) {
+  if (!ok) {
+    ++failures();
+    std::cerr << "FAIL: " << what << "\n";
+  }
+}
+
+// Exit status for main().
+inline int finish(const char *name) {
+  if (failures()) {
+    std::cerr << name << ": " << failures() << " check(s) failed\n";
+    return 1;
+  }
+  std::cout << name << ": all checks passed\n";
+  return 0;
+}
+
+inline const char *op_name(Op op) {
+  static const char *names[] = {"lt", "eq", "between", "gt", "ge", "le", "ne", "in"};
+  return names[static_cast<int>(op)];
+}
+
+inline std::string describe(const QuerySpec &q) {
+  std::string s = std::string(op_name(q.op)) + " v1=" + std::to_string(q.v1);
+  if (q.op == Op::BETWEEN) {
+    s += " v2=" + std::to_string(q.v2);
+  }
+  for (uint64_t v : q.values) {
+    s += " " + std::to_string(v);
+  }
+  return s;
+}
+
+template <class Alloc>
+BitVector brute(const std::vector<uint64_t, Alloc> &keys, const QuerySpec &q, const BitVector *dead = nullptr) {
+  BitVector out(keys.size());
+  for (size_t r = 0; r < keys.size(); ++r) {
+    if ((!dead || !dead->get(r)) && q.matches(keys[r])) {
+      out.set(r);
+    }
+  }
+  return out;
+}
+
+// Columns with the shapes the map builders special-case: wide uniform
+// values, heavy hitters among rare values, few distinct values (no ranges)
+// and values packed against both ends of the key space.
+constexpr int kShapes = 4;
+
+inline ColumnVector<uint64_t> make_column(int shape, size_t N, std::mt19937_64 &rng) {
+  ColumnVector<uint64_t> keys(N);
+  const uint64_t top = std::numeric_limits<uint64_t>::max();
+  for (auto &k : keys) {
+    switch (shape) {
+    case 0: k = rng() % 1000000; break;
+    case 1: k = rng() % 4 == 0 ? 42 + 1000 * (rng() % 20) : rng() % 100000; break;
+    case 2: k = 3 * (rng() % 40); break;
+    default: k = rng() % 2 ? rng() % 300 : top - rng() % 300; break;
+    }
+  }
+  return keys;
+}
+
+// Constants at stored keys, next to them (often unstored), and at the
+// ends of the domain.
+template <class Alloc>
+uint64_t pick_constant(const std::vector<uint64_t, Alloc> &keys, std::mt19937_64 &rng) {
+  switch (rng() % 6) {
+  case 0: return 0;
+  case 1: return std::numeric_limits<uint64_t>::max();
+  case 2: return keys[rng() % keys.size()] + 1;
+  case 3: return keys[rng() % keys.size()] - 1;
+  default: return keys[rng() % keys.size()];
+  }
+}
+
+// A random predicate; BETWEEN is sometimes left with v2 < v1.
+template <class Alloc>
+QuerySpec make_query(Op op, const std::vector<uint64_t, Alloc> &keys, std::mt19937_64 &rng) {
+  QuerySpec q;
+  q.op = op;
+  q.v1 = pick_constant(keys, rng);
+  q.v2 = pick_constant(keys, rng);
+  if (q.v2 < q.v1 && rng() % 4) {
+    std::swap(q.v1, q.v2);
+  }
+  if (op == Op::IN) {
+    for (size_t i = 1 + rng() % 6; i > 0; --i) {
+      q.values.push_back(pick_constant(keys, rng));
+    }
+    std::sort(q.values.begin(), q.values.end());
+    q.values.erase(std::unique(q.values.begin(), q.values.end()), q.values.end());
+  }
+  return q;
+}
+
+inline std::string temp_file(const std::string &name) { return "csketch_test_" + name; }
+
+// A column with its map and codes.
+struct Fixture {
+  ColumnVector<uint64_t> keys;
+  LoadedMap map;
+  EncodedSketch sk;
+  std::string tag;
+
+  const void *codes() const { return sk.data(); }
+  bool codes16() const { return sk.code_bits == 16; }
+};
+
+// Every column shape, mapped by build() and build_optimal() into 8- and
+// 16-bit codes.
+template <class Fn>
+void for_each_fixture(std::mt19937_64 &rng, Fn &&fn) {
+  for (int shape = 0; shape < kShapes; ++shape) {
+    const size_t N = 3000 + rng() % 20000;
+    const ColumnVector<uint64_t> keys = make_column(shape, N, rng);
+    for (int builder = 0; builder < 2; ++builder) {
+      for (uint32_t max_codes : {256u, 4096u}) {
+        Fixture f;
+        f.keys = keys;
+        const size_t cutoff = shape == 1 ? 500 : 1;
+        f.map.art = builder ? NumericCompressionMap::build_optimal(keys, max_codes, 4096, cutoff)
+                            : NumericCompressionMap::build(keys, max_codes, 4096, cutoff);
+        f.map.dtype = "u64";
+        f.sk = encode_sketch(f.map.art, keys, 2);
+        f.map.code_bits = f.sk.code_bits;
+        f.map.stats = code_stats(f.sk, f.keys.data(), N, DType::U64, 2);
+        f.tag = "shape " + std::to_string(shape) + (builder ? " build_optimal" : " build") + " codes " +
+                std::to_string(max_codes);
+        fn(f);
+      }
+    }
+  }
+}
+
+} // namespace csketch_test
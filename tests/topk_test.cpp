@@ -0,0 +1,52 @@
+// top_k returns the k smallest or largest keys' rows, ties to the lower row
+// id, at every ISA level.
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "csketch/simd.hpp"
+#include "csketch/topk.hpp"
+#include "test_util.hpp"
+
+using namespace csketch_test;
+
+namespace {
+
+void check_top_k(const Fixture &f, std::mt19937_64 &rng) {
+  std::vector<std::pair<uint64_t, uint64_t>> order; // (key, row)
+  for (size_t r = 0; r < f.keys.size(); ++r) {
+    order.emplace_back(f.keys[r], r);
+  }
+  std::sort(order.begin(), order.end());
+  auto largest_first = order;
+  std::stable_sort(largest_first.begin(), largest_first.end(),
+                   [](const auto &a, const auto &b) { return a.first > b.first; });
+
+  for (int isa = 0; isa <= static_cast<int>(best_isa()); ++isa) {
+    isa_policy() = static_cast<Isa>(isa);
+    for (bool largest : {false, true}) {
+      const size_t k = 1 + rng() % 300;
+      const TopK got = top_k(f.map, f.codes(), f.codes16(), f.keys.data(), f.keys.size(), k, largest,
+                             1 + static_cast<unsigned>(rng() % 3));
+      std::vector<uint64_t> want;
+      for (size_t i = 0; i < k; ++i) {
+        want.push_back((largest ? largest_first : order)[i].second);
+      }
+      check(got.rows == want, f.tag + " top_k k=" + std::to_string(k) + (largest ? " largest" : "") +
+                                  " isa=" + std::to_string(isa));
+    }
+  }
+  isa_policy() = best_isa();
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 rng(41);
+  for_each_fixture(rng, [&](const Fixture &f) { check_top_k(f, rng); });
+  return finish("topk_test");
+}